@@ -0,0 +1,200 @@
+#pragma once
+
+#include "../include/raylib.h"
+#include "../include/raymath.h"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+using std::vector;
+
+namespace ssr
+{
+
+    struct aabb_t
+    {
+        Vector3 min;
+        Vector3 max;
+    };
+
+    // what a traversal test says about a node's box
+    enum bvh_test_t
+    {
+        BVH_OUTSIDE,    // nothing under the node is wanted
+        BVH_INTERSECTS, // look at the children
+        BVH_INSIDE,     // everything under the node is wanted, no more tests needed
+    };
+
+    // bounding volume hierarchy over a list of boxes, one item per box. it is built once for a set of items and then
+    // refit in place when some of the boxes move: only the nodes on the way from a moved item to the root are touched.
+    // refitting keeps the tree valid but not as tight as a fresh build, so rebuild after big changes.
+    class bvh_t
+    {
+    private:
+        // the items under a node are items[first_item, first_item + item_count). interior nodes have their children
+        // at left and left + 1, leaves have left == 0 (the root is never anyone's child).
+        struct node_t
+        {
+            aabb_t box;
+            uint32_t first_item;
+            uint32_t item_count;
+            uint32_t left;
+            uint32_t parent;
+        };
+
+        static constexpr uint32_t max_leaf_items = 4;
+
+        vector<node_t> nodes;
+        vector<uint32_t> items;     // item indices, grouped by node
+        vector<uint32_t> item_leaf; // leaf node of every item
+        vector<uint32_t> build_stack; // kept between builds so rebuilding doesn't allocate
+
+        static aabb_t merge(const aabb_t &a, const aabb_t &b)
+        {
+            return {Vector3Min(a.min, b.min), Vector3Max(a.max, b.max)};
+        }
+
+        static bool same_box(const aabb_t &a, const aabb_t &b)
+        {
+            return a.min.x == b.min.x && a.min.y == b.min.y && a.min.z == b.min.z &&
+                   a.max.x == b.max.x && a.max.y == b.max.y && a.max.z == b.max.z;
+        }
+
+        aabb_t leaf_box(const node_t &leaf, const aabb_t *boxes) const
+        {
+            aabb_t box = boxes[items[leaf.first_item]];
+            for (uint32_t i = leaf.first_item + 1; i < leaf.first_item + leaf.item_count; i++)
+            {
+                box = merge(box, boxes[items[i]]);
+            }
+            return box;
+        }
+
+    public:
+        bool empty() const
+        {
+            return nodes.empty();
+        }
+
+        // top down build, every node is split at the median box center along its longest axis
+        void build(const aabb_t *boxes, size_t count)
+        {
+            nodes.clear();
+            items.resize(count);
+            item_leaf.resize(count);
+
+            if (count == 0)
+                return;
+
+            for (size_t i = 0; i < count; i++)
+            {
+                items[i] = (uint32_t)i;
+            }
+
+            nodes.reserve(count);
+            nodes.push_back({{}, 0, (uint32_t)count, 0, 0});
+
+            vector<uint32_t> &stack = build_stack;
+            stack.clear();
+            stack.push_back(0);
+            while (!stack.empty())
+            {
+                uint32_t node_index = stack.back();
+                stack.pop_back();
+
+                node_t node = nodes[node_index];
+                node.box = leaf_box(node, boxes);
+
+                if (node.item_count <= max_leaf_items)
+                {
+                    for (uint32_t i = node.first_item; i < node.first_item + node.item_count; i++)
+                    {
+                        item_leaf[items[i]] = node_index;
+                    }
+                    nodes[node_index] = node;
+                    continue;
+                }
+
+                auto center = [&](uint32_t item, int axis)
+                {
+                    const aabb_t &b = boxes[item];
+                    return axis == 0 ? b.min.x + b.max.x : axis == 1 ? b.min.y + b.max.y : b.min.z + b.max.z;
+                };
+
+                Vector3 extent = Vector3Subtract(node.box.max, node.box.min);
+                int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : extent.y >= extent.z ? 1 : 2;
+
+                uint32_t *first = &items[node.first_item];
+                uint32_t half = node.item_count / 2;
+                std::nth_element(first, first + half, first + node.item_count, [&](uint32_t a, uint32_t b)
+                                 { return center(a, axis) < center(b, axis); });
+
+                node.left = (uint32_t)nodes.size();
+                nodes[node_index] = node;
+
+                nodes.push_back({{}, node.first_item, half, 0, node_index});
+                nodes.push_back({{}, node.first_item + half, node.item_count - half, 0, node_index});
+
+                stack.push_back(node.left);
+                stack.push_back(node.left + 1);
+            }
+        }
+
+        // updates the boxes of the nodes above the given items after their boxes changed
+        void refit(const aabb_t *boxes, const uint32_t *moved, size_t moved_count)
+        {
+            for (size_t m = 0; m < moved_count; m++)
+            {
+                uint32_t node_index = item_leaf[moved[m]];
+                nodes[node_index].box = leaf_box(nodes[node_index], boxes);
+
+                while (node_index != 0)
+                {
+                    node_index = nodes[node_index].parent;
+                    node_t &node = nodes[node_index];
+
+                    aabb_t box = merge(nodes[node.left].box, nodes[node.left + 1].box);
+                    if (same_box(box, node.box))
+                        break; // nothing above can change either
+
+                    node.box = box;
+                }
+            }
+        }
+
+        // calls visit(item) for every item whose box isn't ruled out by test(const aabb_t&) -> bvh_test_t.
+        // items below a node that tests BVH_INSIDE are visited without testing them any further.
+        template <typename T, typename F>
+        void traverse(T &&test, F &&visit) const
+        {
+            if (nodes.empty())
+                return;
+
+            uint32_t stack[64];
+            int stack_size = 0;
+            stack[stack_size++] = 0;
+
+            while (stack_size > 0)
+            {
+                const node_t &node = nodes[stack[--stack_size]];
+
+                bvh_test_t result = test(node.box);
+                if (result == BVH_OUTSIDE)
+                    continue;
+
+                if (result == BVH_INSIDE || node.left == 0)
+                {
+                    for (uint32_t i = node.first_item; i < node.first_item + node.item_count; i++)
+                    {
+                        visit(items[i]);
+                    }
+                    continue;
+                }
+
+                stack[stack_size++] = node.left + 1;
+                stack[stack_size++] = node.left;
+            }
+        }
+    };
+
+}
@@ -0,0 +1,191 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+using std::vector;
+
+namespace ssr
+{
+
+    // linear allocator for scratch memory that only lives until the end of a frame. allocate just bumps an offset
+    // and reset drops everything at once. when a frame needs more than the current block, extra blocks come from
+    // the heap and the next reset replaces them with one block big enough for the whole frame, so a frame that
+    // needs no more memory than the ones before it never touches the heap.
+    class frame_arena_t
+    {
+    private:
+        static constexpr size_t block_alignment = 64;
+
+        struct block_t
+        {
+            std::byte *data;
+            size_t size;
+        };
+
+        vector<block_t> blocks; // the last one is the one being filled
+        size_t offset = 0;      // into the last block
+        size_t frame_used = 0;  // bytes handed out since the last reset, alignment padding included
+        size_t peak_used = 0;   // the most any earlier frame used
+        int frame_heap_allocations = 0;
+
+        void add_block(size_t size)
+        {
+            blocks.push_back({(std::byte *)::operator new(size, std::align_val_t(block_alignment)), size});
+            offset = 0;
+        }
+
+        void free_blocks()
+        {
+            for (block_t &b : blocks)
+            {
+                ::operator delete(b.data, std::align_val_t(block_alignment));
+            }
+            blocks.clear();
+        }
+
+    public:
+        explicit frame_arena_t(size_t initial_size = 1 << 20)
+        {
+            blocks.reserve(16);
+            add_block(initial_size);
+        }
+
+        ~frame_arena_t()
+        {
+            free_blocks();
+        }
+
+        frame_arena_t(const frame_arena_t &) = delete;
+        frame_arena_t &operator=(const frame_arena_t &) = delete;
+
+        // alignment has to be a power of two no bigger than 64
+        void *allocate(size_t bytes, size_t alignment = alignof(std::max_align_t))
+        {
+            assert(alignment <= block_alignment && (alignment & (alignment - 1)) == 0);
+
+            size_t start = (offset + alignment - 1) & ~(alignment - 1);
+
+            if (start + bytes > blocks.back().size)
+            {
+                add_block(std::max(bytes, blocks.back().size * 2));
+                frame_heap_allocations++;
+                start = 0;
+            }
+
+            frame_used += start - offset + bytes;
+            offset = start + bytes;
+
+            return blocks.back().data + start;
+        }
+
+        // uninitialized room for count T's
+        template <typename T>
+        T *allocate(size_t count)
+        {
+            static_assert(std::is_trivially_destructible_v<T>, "nothing in the arena gets destroyed");
+            return (T *)allocate(count * sizeof(T), alignof(T));
+        }
+
+        // everything allocated since the last reset becomes invalid
+        void reset()
+        {
+            peak_used = std::max(peak_used, frame_used);
+
+            if (blocks.size() > 1)
+            {
+                size_t total = 0;
+                for (const block_t &b : blocks)
+                {
+                    total += b.size;
+                }
+
+                free_blocks();
+                add_block(total);
+            }
+
+            offset = 0;
+            frame_used = 0;
+            frame_heap_allocations = 0;
+        }
+
+        // bytes handed out since the last reset
+        size_t used() const
+        {
+            return frame_used;
+        }
+
+        // the most bytes any frame before the current one used
+        size_t peak() const
+        {
+            return peak_used;
+        }
+
+        // number of times the current frame had to get a new block from the heap
+        int heap_allocations() const
+        {
+            return frame_heap_allocations;
+        }
+    };
+
+    // growable array living in a frame_arena_t. growing moves the items into a new allocation twice the size and
+    // leaves the old one behind until the arena is reset. T has to be trivially copyable.
+    template <typename T>
+    class frame_vector_t
+    {
+    private:
+        static_assert(std::is_trivially_copyable_v<T>, "items are moved with memcpy");
+
+        frame_arena_t *arena = nullptr;
+        T *items = nullptr;
+        size_t count = 0;
+        size_t capacity = 0;
+
+    public:
+        frame_vector_t() = default;
+
+        explicit frame_vector_t(frame_arena_t &arena, size_t initial_capacity = 0)
+        {
+            this->arena = &arena;
+            reserve(initial_capacity);
+        }
+
+        void reserve(size_t n)
+        {
+            if (n <= capacity)
+                return;
+
+            T *grown = arena->allocate<T>(n);
+            if (count > 0)
+                std::memcpy((void *)grown, (const void *)items, count * sizeof(T));
+
+            items = grown;
+            capacity = n;
+        }
+
+        void push_back(const T &item)
+        {
+            if (count == capacity)
+                reserve(capacity < 16 ? 16 : capacity * 2);
+
+            items[count++] = item;
+        }
+
+        T &operator[](size_t i) { return items[i]; }
+        const T &operator[](size_t i) const { return items[i]; }
+
+        size_t size() const { return count; }
+        bool empty() const { return count == 0; }
+
+        T *begin() { return items; }
+        T *end() { return items + count; }
+        const T *begin() const { return items; }
+        const T *end() const { return items + count; }
+    };
+
+}
@@ -38,12 +38,18 @@ int main(void)
                                          300.0f);
 
     ssr::Renderer renderer = ssr::Renderer("res/crate.png");
+    renderer.enable_tiled_rendering(); // one worker per core, 64x64 tiles
 
     ssr::model_loader m;
     ssr::model_t model = m.load_obj_data(get_full_path("res/crate2.obj"));
 
     model.transform.position = (Vector3){0, 0, 12};
 
+    // the scene keeps the mesh for the whole run, the loop only updates the instance's transform
+    ssr::scene_t scene;
+    ssr::mesh_handle_t crate_mesh = scene.add_mesh(std::move(model.mesh));
+    ssr::instance_handle_t crate = scene.add_instance(crate_mesh, model.transform);
+
     SetTargetFPS(60);
 
     float angle_in_deg = 0;
@@ -54,13 +60,12 @@ int main(void)
         camera.rotate();
         
         angle_in_deg += 2;
-        model.transform.rotation = (Vector3){DEG2RAD * angle_in_deg, DEG2RAD * angle_in_deg, 0};
-
-        BeginDrawing();
-        ClearBackground(RAYWHITE);
+        scene.transform(crate).rotation = (Vector3){DEG2RAD * angle_in_deg, DEG2RAD * angle_in_deg, 0};
 
-        renderer.render_scene(vector<ssr::model_t>{model}, camera);
+        renderer.render_scene(scene, camera);
 
+        BeginDrawing();
+        renderer.present();
         EndDrawing();
     }
 
@@ -0,0 +1,358 @@
+#pragma once
+
+#include "rendering.h"
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using std::string;
+using std::vector;
+
+namespace ssr
+{
+
+    // the meshes a loader cooked out of a source file, written next to it so later loads can skip parsing and
+    // building. the file is a header, one entry per mesh (the mesh first, then its lods) and the arrays of every
+    // mesh. arrays start at multiples of mesh_cache_alignment from the start of the file, so they can be read with
+    // aligned simd loads straight from the mapping. everything is in the machine's own byte order.
+    //
+    // loading still copies every array out of the mapping into the mesh's vectors, one memcpy each, because mesh_t
+    // owns its arrays. using them in place is still to do.
+    constexpr char mesh_cache_magic[8] = {'s', 's', 'r', 'm', 'e', 's', 'h', '\0'};
+    constexpr uint32_t mesh_cache_version = 2; // bump whenever the layout or the way meshes are built changes
+    constexpr size_t mesh_cache_alignment = 64;
+
+    struct mesh_cache_header_t
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t mesh_count;
+        uint64_t source_size; // a cache whose source changed size is stale whatever the timestamps say
+        uint32_t stream_padding; // vertex_stream_padding of the writer
+        uint32_t reserved;
+    };
+
+    // count elements starting offset bytes into the file
+    struct mesh_cache_section_t
+    {
+        uint64_t offset;
+        uint64_t count;
+    };
+
+    struct mesh_cache_entry_t
+    {
+        mesh_cache_section_t vertices;
+        mesh_cache_section_t uvs;
+        mesh_cache_section_t normals;
+        mesh_cache_section_t indices;
+        mesh_cache_section_t position_x;
+        mesh_cache_section_t position_y;
+        mesh_cache_section_t position_z;
+        mesh_cache_section_t clusters;
+        uint32_t index_size; // 2 or 4 bytes
+        float lod_error;
+        bounds_t bounds;
+    };
+
+    // read only view of a whole file
+    class mapped_file_t
+    {
+    private:
+        const char *bytes = nullptr;
+        size_t length = 0;
+
+    public:
+        explicit mapped_file_t(const string &path)
+        {
+            int fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                return;
+
+            struct stat st;
+            if (fstat(fd, &st) == 0 && st.st_size > 0)
+            {
+                void *p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p != MAP_FAILED)
+                {
+                    bytes = (const char *)p;
+                    length = (size_t)st.st_size;
+                }
+            }
+            close(fd); // the mapping stays valid
+        }
+
+        ~mapped_file_t()
+        {
+            if (bytes)
+                munmap((void *)bytes, length);
+        }
+
+        mapped_file_t(const mapped_file_t &) = delete;
+        mapped_file_t &operator=(const mapped_file_t &) = delete;
+
+        const char *data() const
+        {
+            return bytes;
+        }
+
+        size_t size() const
+        {
+            return length;
+        }
+    };
+
+    string mesh_cache_path(const string &source_path)
+    {
+        return source_path + ".ssrmesh";
+    }
+
+    // true when every index and cluster of m stays inside m's arrays, so a corrupt cache can't make the renderer read
+    // out of bounds. the vertex stage loads whole vectors of the position streams from a cluster's first vertex on, so
+    // clusters also have to start and end on multiples of vertex_stream_padding.
+    bool is_valid_cached_mesh(const mesh_t &m)
+    {
+        size_t vertex_count = m.vertices.size();
+        size_t face_count = m.face_count();
+
+        if (m.indices.size() % 3 != 0 || m.uvs.size() != vertex_count ||
+            (!m.normals.empty() && m.normals.size() != vertex_count))
+            return false;
+
+        size_t padded = padded_vertex_count(vertex_count);
+        if (m.position_x.size() != padded || m.position_y.size() != padded || m.position_z.size() != padded)
+            return false;
+
+        for (size_t i = 0; i < m.indices.size(); i++)
+        {
+            if (m.indices[i] >= vertex_count)
+                return false;
+        }
+
+        for (const cluster_t &c : m.clusters)
+        {
+            if ((uint64_t)c.first_face + c.face_count > face_count ||
+                (uint64_t)c.first_vertex + c.vertex_count > padded ||
+                c.first_vertex % vertex_stream_padding != 0 || c.vertex_count % vertex_stream_padding != 0)
+                return false;
+
+            for (size_t f = c.first_face; f < c.first_face + c.face_count; f++)
+            {
+                triangle_t t = m.face(f);
+                if (t.v1 < c.first_vertex || t.v2 < c.first_vertex || t.v3 < c.first_vertex ||
+                    t.v1 - c.first_vertex >= c.vertex_count || t.v2 - c.first_vertex >= c.vertex_count ||
+                    t.v3 - c.first_vertex >= c.vertex_count)
+                    return false;
+            }
+        }
+
+        return true;
+    }
+
+    // fills mesh and its lods from the cache of source_path. false when there is no cache, or it is older than the
+    // source, or was written for another version or source, or doesn't hold up to is_valid_cached_mesh, and mesh is
+    // left alone then.
+    bool load_mesh_cache(const string &source_path, mesh_t &mesh)
+    {
+        namespace fs = std::filesystem;
+        string cache_path = mesh_cache_path(source_path);
+
+        std::error_code error;
+        auto source_time = fs::last_write_time(source_path, error);
+        if (error)
+            return false;
+        auto cache_time = fs::last_write_time(cache_path, error);
+        if (error || cache_time < source_time)
+            return false;
+        uintmax_t source_size = fs::file_size(source_path, error);
+        if (error)
+            return false;
+
+        mapped_file_t file(cache_path);
+        if (file.size() < sizeof(mesh_cache_header_t))
+            return false;
+
+        mesh_cache_header_t header;
+        memcpy(&header, file.data(), sizeof(header));
+        if (memcmp(header.magic, mesh_cache_magic, sizeof(header.magic)) != 0 || header.version != mesh_cache_version ||
+            header.stream_padding != vertex_stream_padding || header.source_size != source_size || header.mesh_count == 0)
+            return false;
+
+        if ((file.size() - sizeof(header)) / sizeof(mesh_cache_entry_t) < header.mesh_count)
+            return false;
+
+        vector<mesh_cache_entry_t> entries(header.mesh_count);
+        memcpy(entries.data(), file.data() + sizeof(header), entries.size() * sizeof(mesh_cache_entry_t));
+
+        // every section has to be aligned and inside the file before anything is read
+        auto fits = [&](const mesh_cache_section_t &s, size_t element_size)
+        {
+            return s.offset % mesh_cache_alignment == 0 && s.offset <= file.size() &&
+                   s.count <= (file.size() - s.offset) / element_size;
+        };
+
+        for (const mesh_cache_entry_t &e : entries)
+        {
+            if (e.index_size != (e.vertices.count <= 65536 ? 2u : 4u))
+                return false;
+
+            if (!fits(e.vertices, sizeof(Vector3)) || !fits(e.uvs, sizeof(Vector2)) || !fits(e.normals, sizeof(Vector3)) ||
+                !fits(e.indices, e.index_size) || !fits(e.position_x, sizeof(float)) ||
+                !fits(e.position_y, sizeof(float)) || !fits(e.position_z, sizeof(float)) ||
+                !fits(e.clusters, sizeof(cluster_t)))
+                return false;
+        }
+
+        auto read = [&](auto &out, const mesh_cache_section_t &s)
+        {
+            using T = typename std::decay_t<decltype(out)>::value_type;
+            const T *first = (const T *)(file.data() + s.offset);
+            out.assign(first, first + s.count);
+        };
+
+        auto read_mesh = [&](const mesh_cache_entry_t &e, mesh_t &m)
+        {
+            read(m.vertices, e.vertices);
+            read(m.uvs, e.uvs);
+            read(m.normals, e.normals);
+            m.indices.assign_packed(file.data() + e.indices.offset, e.indices.count, e.index_size == 2);
+            read(m.position_x, e.position_x);
+            read(m.position_y, e.position_y);
+            read(m.position_z, e.position_z);
+            read(m.clusters, e.clusters);
+            m.bounds = e.bounds;
+            m.lod_error = e.lod_error;
+            return is_valid_cached_mesh(m);
+        };
+
+        mesh_t cached;
+        if (!read_mesh(entries[0], cached))
+            return false;
+
+        cached.lods.resize(entries.size() - 1);
+        for (size_t i = 1; i < entries.size(); i++)
+        {
+            if (!read_mesh(entries[i], cached.lods[i - 1]))
+                return false;
+        }
+
+        mesh = std::move(cached);
+        return true;
+    }
+
+    // writes the cache of source_path for mesh and its lods. goes through a temporary file, so a reader never sees a
+    // half written cache.
+    bool save_mesh_cache(const string &source_path, const mesh_t &mesh)
+    {
+        namespace fs = std::filesystem;
+        string cache_path = mesh_cache_path(source_path);
+        string temp_path = cache_path + ".tmp";
+
+        std::error_code error;
+        uintmax_t source_size = fs::file_size(source_path, error);
+        if (error)
+            return false;
+
+        vector<const mesh_t *> meshes = {&mesh};
+        for (const mesh_t &lod : mesh.lods)
+        {
+            meshes.push_back(&lod);
+        }
+
+        auto align = [](uint64_t offset)
+        {
+            return (offset + mesh_cache_alignment - 1) / mesh_cache_alignment * mesh_cache_alignment;
+        };
+
+        // lay the sections out one after the other, in the order they get written below
+        uint64_t offset = align(sizeof(mesh_cache_header_t) + meshes.size() * sizeof(mesh_cache_entry_t));
+        auto place = [&](mesh_cache_section_t &s, size_t count, size_t element_size)
+        {
+            s = {offset, count};
+            offset = align(offset + count * element_size);
+        };
+
+        vector<mesh_cache_entry_t> entries(meshes.size());
+        for (size_t i = 0; i < meshes.size(); i++)
+        {
+            const mesh_t &m = *meshes[i];
+            mesh_cache_entry_t &e = entries[i];
+            e = {};
+            e.index_size = m.indices.is_16bit() ? 2 : 4;
+            e.lod_error = m.lod_error;
+            e.bounds = m.bounds;
+
+            place(e.vertices, m.vertices.size(), sizeof(Vector3));
+            place(e.uvs, m.uvs.size(), sizeof(Vector2));
+            place(e.normals, m.normals.size(), sizeof(Vector3));
+            place(e.indices, m.indices.size(), e.index_size);
+            place(e.position_x, m.position_x.size(), sizeof(float));
+            place(e.position_y, m.position_y.size(), sizeof(float));
+            place(e.position_z, m.position_z.size(), sizeof(float));
+            place(e.clusters, m.clusters.size(), sizeof(cluster_t));
+        }
+
+        mesh_cache_header_t header = {};
+        memcpy(header.magic, mesh_cache_magic, sizeof(header.magic));
+        header.version = mesh_cache_version;
+        header.mesh_count = (uint32_t)meshes.size();
+        header.source_size = source_size;
+        header.stream_padding = vertex_stream_padding;
+
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        if (!file)
+            return false;
+
+        uint64_t written = 0;
+        auto write = [&](uint64_t at, const void *data, size_t bytes)
+        {
+            static const char zeros[mesh_cache_alignment] = {};
+            while (written < at)
+            {
+                size_t gap = (size_t)std::min<uint64_t>(at - written, sizeof(zeros));
+                file.write(zeros, gap);
+                written += gap;
+            }
+
+            if (bytes > 0)
+                file.write((const char *)data, bytes);
+            written += bytes;
+        };
+
+        write(0, &header, sizeof(header));
+        write(sizeof(header), entries.data(), entries.size() * sizeof(mesh_cache_entry_t));
+
+        for (size_t i = 0; i < meshes.size(); i++)
+        {
+            const mesh_t &m = *meshes[i];
+            const mesh_cache_entry_t &e = entries[i];
+
+            write(e.vertices.offset, m.vertices.data(), m.vertices.size() * sizeof(Vector3));
+            write(e.uvs.offset, m.uvs.data(), m.uvs.size() * sizeof(Vector2));
+            write(e.normals.offset, m.normals.data(), m.normals.size() * sizeof(Vector3));
+            write(e.indices.offset, m.indices.data(), m.indices.size() * e.index_size);
+            write(e.position_x.offset, m.position_x.data(), m.position_x.size() * sizeof(float));
+            write(e.position_y.offset, m.position_y.data(), m.position_y.size() * sizeof(float));
+            write(e.position_z.offset, m.position_z.data(), m.position_z.size() * sizeof(float));
+            write(e.clusters.offset, m.clusters.data(), m.clusters.size() * sizeof(cluster_t));
+        }
+
+        file.close();
+        if (!file)
+        {
+            fs::remove(temp_path, error);
+            return false;
+        }
+
+        fs::rename(temp_path, cache_path, error);
+        return !error;
+    }
+}
@@ -2,9 +2,18 @@
 
 #include "../include/raylib.h"
 #include "../include/raymath.h"
+#include "mesh_cache.h"
 #include "rendering.h"
+#include "simplify.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -17,114 +26,689 @@ using std::endl;
 namespace ssr
 {
 
+    // one corner of an obj face, indices into the file's position, uv and normal lists
+    struct tri_indicies
+    {
+        int p;// position
+        int uv; // uv coordinates
+        int n; // normals
+
+        bool operator==(const tri_indicies &o) const
+        {
+            return p == o.p && uv == o.uv && n == o.n;
+        }
+    };
+
+    // reads obj files from one buffer holding the whole file. numbers are parsed in place and nothing is allocated per
+    // line or token. big files are cut into chunks at line starts and the chunks are parsed on all cores, each into
+    // its own lists, which are then joined into the lists below.
     class model_loader
     {
     private:
+        // a face with more than three corners. while parsing it is written to the corners as the fan of triangles
+        // (0 1 2) (0 2 3) ... (0 n-2 n-1), except for quads which become (0 1 2) (2 3 0). faces that turn out not to
+        // be convex are triangulated again by triangulate_polygons once all positions are known.
+        struct obj_polygon_t
+        {
+            size_t first_corner;
+            uint32_t corner_count;
+        };
+
+        // what one chunk of the file holds. corners use absolute (positive in the file) indices as they are. relative
+        // (negative) indices only mean something once the number of entries before the chunk is known, until then
+        // they are kept as chunk local indices minus relative_index_bias.
+        struct obj_chunk_t
+        {
+            vector<Vector3> vertices;
+            vector<Vector2> uvs;
+            vector<Vector3> normals;
+            vector<tri_indicies> corners; // three per triangle, 0 based
+            vector<obj_polygon_t> polygons;
+        };
+
+        static constexpr int relative_index_bias = 1 << 30;
+        static constexpr size_t min_chunk_bytes = 1 << 20;
+
         vector<Vector3> vertices;
         vector<Vector2> uvs;
         vector<Vector3> normals;
-        vector<triangle_t> faces;
+        vector<tri_indicies> corners; // three per triangle, 0 based
+        vector<obj_polygon_t> polygons;
+
+        vector<obj_chunk_t> chunks;
+        std::unique_ptr<thread_pool_t> workers; // made for the first file big enough to be split
+
+        // corner -> mesh vertex. the distinct corners of every position are chained, starting at
+        // position_first_vertex[p] and following next_vertex. no_vertex ends a chain.
+        static constexpr uint32_t no_vertex = UINT32_MAX;
+        vector<tri_indicies> vertex_corners;
+        vector<uint32_t> position_first_vertex;
+        vector<uint32_t> next_vertex;
+
+        static bool is_digit(char c)
+        {
+            return c >= '0' && c <= '9';
+        }
+
+        static bool is_space(char c)
+        {
+            return c == ' ' || c == '\t' || c == '\r';
+        }
+
+        static const char *skip_spaces(const char *p, const char *end)
+        {
+            while (p < end && is_space(*p))
+                p++;
+            return p;
+        }
+
+        // to the start of the next line
+        static const char *skip_line(const char *p, const char *end)
+        {
+            while (p < end && *p != '\n')
+                p++;
+            return p < end ? p + 1 : p;
+        }
+
+        // true when the line at p starts with keyword followed by a space
+        static bool starts_with(const char *p, const char *end, const char *keyword)
+        {
+            for (; *keyword; keyword++, p++)
+            {
+                if (p == end || *p != *keyword)
+                    return false;
+            }
+            return p < end && is_space(*p);
+        }
 
-        vector<string> string_split(const string& str, const string& delimeter)
+        static double power_of_ten(int e)
         {
-            vector<string> result;
-            size_t previos_index = 0;
+            // exact in a double up to 1e22
+            static const double table[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                           1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+            return e <= 22 ? table[e] : std::pow(10.0, e);
+        }
+
+        // decimal number with an optional sign, fraction and exponent. returns where the number ends, or p with out
+        // set to 0 when there is no number at p. the digits are gathered into an integer and scaled by one exact
+        // power of ten, which rounds the same as stof for anything an obj file holds.
+        static const char *parse_float(const char *p, const char *end, float &out)
+        {
+            const char *start = p;
+            out = 0;
 
-            for (size_t i = 0; i < str.length(); i++)
+            bool negative = false;
+            if (p < end && (*p == '-' || *p == '+'))
+                negative = *p++ == '-';
+
+            uint64_t mantissa = 0;
+            int significant = 0; // digits in mantissa, 19 of them always fit
+            int exponent = 0;
+            bool any_digit = false;
+
+            for (; p < end && is_digit(*p); p++)
             {
-                if (str[i] == delimeter[0])
+                any_digit = true;
+                if (significant < 19)
                 {
-                    result.push_back(str.substr(previos_index, i - previos_index));
-                    previos_index = i + 1;
+                    mantissa = mantissa * 10 + (*p - '0');
+                    significant += mantissa != 0;
                 }
-                // this ads from last delimeter to end of the string.
-                if (i == (str.length() - 1))
+                else
+                    exponent++;
+            }
+
+            if (p < end && *p == '.')
+            {
+                for (p++; p < end && is_digit(*p); p++)
                 {
-                    result.push_back(str.substr(previos_index, i - previos_index + 1));
+                    any_digit = true;
+                    if (significant < 19)
+                    {
+                        mantissa = mantissa * 10 + (*p - '0');
+                        significant += mantissa != 0;
+                        exponent--;
+                    }
                 }
             }
-            return result;
+
+            if (!any_digit)
+                return start;
+
+            if (p < end && (*p == 'e' || *p == 'E'))
+            {
+                const char *q = p + 1;
+                bool negative_exponent = false;
+                if (q < end && (*q == '-' || *q == '+'))
+                    negative_exponent = *q++ == '-';
+
+                if (q < end && is_digit(*q))
+                {
+                    int e = 0;
+                    for (; q < end && is_digit(*q); q++)
+                    {
+                        e = std::min(e * 10 + (*q - '0'), 1000);
+                    }
+                    exponent += negative_exponent ? -e : e;
+                    p = q;
+                }
+            }
+
+            double value = (double)mantissa;
+            if (exponent < 0)
+                value /= power_of_ten(-exponent);
+            else if (exponent > 0)
+                value *= power_of_ten(exponent);
+
+            out = (float)(negative ? -value : value);
+            return p;
         }
 
-        Vector3 read_vec3(const vector<string>& words)
+        static const char *parse_int(const char *p, const char *end, int &out)
         {
-            return (Vector3){std::stof(words[1]), std::stof(words[2]), std::stof(words[3])};
+            const char *start = p;
+            out = 0;
+
+            bool negative = false;
+            if (p < end && (*p == '-' || *p == '+'))
+                negative = *p++ == '-';
+
+            if (p == end || !is_digit(*p))
+                return start;
+
+            int64_t value = 0;
+            for (; p < end && is_digit(*p); p++)
+            {
+                value = std::min<int64_t>(value * 10 + (*p - '0'), INT32_MAX);
+            }
+
+            out = (int)(negative ? -value : value);
+            return p;
         }
 
-        Vector2 read_vec2(const vector<string>& words)
+        // count floats separated by spaces, missing ones are left at 0
+        static const char *parse_floats(const char *p, const char *end, float *out, int count)
         {
-            return (Vector2){std::stof(words[1]), std::stof(words[2])};
+            for (int i = 0; i < count; i++)
+            {
+                p = parse_float(skip_spaces(p, end), end, out[i]);
+            }
+            return p;
         }
 
-        void read_vertex(tri_indicies& t, const string& data)
+        // index as written in the file into a 0 based one. count is how many entries of the list the chunk has seen.
+        // missing indices and 0 become -1.
+        static int resolve_index(int index, size_t count)
         {
-            vector<string> splited = string_split(data, "/");
-            t.p = std::stoi(splited[0]) - 1;
-            t.uv = std::stoi(splited[1]) - 1;
-            t.n = std::stoi(splited[2]) - 1;
+            if (index > 0)
+                return index - 1;
+            if (index < 0)
+                return (int)count + index - relative_index_bias;
+            return -1;
         }
 
-    public:
-        model_t load_obj_data(const string& path)
+        // p/uv/n, as written in the file
+        static const char *parse_corner(const char *p, const char *end, tri_indicies &c)
         {
-            string line;
-            vector<string> words;
-
-            vector<string> face_serialized_data;
+            p = parse_int(p, end, c.p);
+            if (p < end && *p == '/')
+                p = parse_int(p + 1, end, c.uv);
+            if (p < end && *p == '/')
+                p = parse_int(p + 1, end, c.n);
+            return p;
+        }
 
-            std::ifstream file;
+        static void parse(const char *p, const char *end, obj_chunk_t &chunk)
+        {
+            vector<Vector3> &vertices = chunk.vertices;
+            vector<Vector2> &uvs = chunk.uvs;
+            vector<Vector3> &normals = chunk.normals;
+            vector<tri_indicies> &corners = chunk.corners;
+            vector<obj_polygon_t> &polygons = chunk.polygons;
 
-            file.open(path);
-            while (std::getline(file, line))
+            while (p < end)
             {
-                words = string_split(line, " ");
+                p = skip_spaces(p, end);
 
-                if (!words[0].compare("v"))
+                if (starts_with(p, end, "v"))
+                {
+                    Vector3 v;
+                    parse_floats(p + 1, end, &v.x, 3);
+                    vertices.push_back(v);
+                }
+                else if (starts_with(p, end, "vt"))
                 {
-                    vertices.push_back(read_vec3(words));
+                    Vector2 uv;
+                    parse_floats(p + 2, end, &uv.x, 2);
+                    uvs.push_back(uv);
                 }
+                else if (starts_with(p, end, "vn"))
+                {
+                    Vector3 n;
+                    parse_floats(p + 2, end, &n.x, 3);
+                    normals.push_back(n);
+                }
+                else if (starts_with(p, end, "f"))
+                {
+                    // every corner after the second adds a fan triangle right away, so faces of any size are read
+                    // without keeping more than the first and the last corner around
+                    size_t first_corner = corners.size();
+                    tri_indicies first = {};
+                    tri_indicies last = {};
+                    uint32_t count = 0;
+
+                    p++;
+                    for (;;)
+                    {
+                        p = skip_spaces(p, end);
+                        if (p == end || *p == '\n' || *p == '#')
+                            break;
+
+                        tri_indicies c = {};
+                        const char *next = parse_corner(p, end, c);
+                        if (next == p)
+                            break;
+
+                        c.p = resolve_index(c.p, vertices.size());
+                        c.uv = resolve_index(c.uv, uvs.size());
+                        c.n = resolve_index(c.n, normals.size());
+
+                        if (count == 0)
+                            first = c;
+                        else if (count >= 2)
+                            corners.insert(corners.end(), {first, last, c});
+
+                        last = c;
+                        count++;
+                        p = next;
+                    }
+
+                    if (count == 4)
+                    {
+                        // the quad a b c d becomes the triangles a b c and c d a
+                        std::rotate(corners.end() - 3, corners.end() - 2, corners.end());
+                    }
+                    if (count >= 4)
+                        polygons.push_back({first_corner, count});
+                }
+
+                p = skip_line(p, end);
+            }
+        }
+
+        // the mesh vertex of a corner, added the first time the corner shows up
+        uint32_t get_vertex(const tri_indicies &c, mesh_t &mesh)
+        {
+            uint32_t *link = &position_first_vertex[c.p];
+            while (*link != no_vertex)
+            {
+                if (vertex_corners[*link] == c)
+                    return *link;
+                link = &next_vertex[*link];
+            }
+
+            uint32_t v = (uint32_t)mesh.vertices.size();
+            *link = v;
+            vertex_corners.push_back(c);
+            next_vertex.push_back(no_vertex);
+
+            mesh.vertices.push_back(vertices[c.p]);
+            mesh.uvs.push_back(c.uv >= 0 && c.uv < (int)uvs.size() ? uvs[c.uv] : Vector2{0, 0});
+            mesh.normals.push_back(c.n >= 0 && c.n < (int)normals.size() ? normals[c.n] : Vector3{0, 0, 0});
+            return v;
+        }
+
+        bool is_valid_position(int p) const
+        {
+            return p >= 0 && p < (int)vertices.size();
+        }
+
+        // cuts data into about equal chunks that start at line starts and parses them, on all cores when there is
+        // more than one
+        void parse_chunks(const char *data, size_t size)
+        {
+            int chunk_count = 1;
+            if (size >= 2 * min_chunk_bytes)
+            {
+                if (!workers)
+                    workers = std::make_unique<thread_pool_t>(0);
+
+                chunk_count = (int)std::min<size_t>(size / min_chunk_bytes, (size_t)workers->size() * 4);
+            }
+
+            vector<const char *> starts(chunk_count + 1);
+            starts[0] = data;
+            starts[chunk_count] = data + size;
+            for (int i = 1; i < chunk_count; i++)
+            {
+                // p - 1 so a cut that lands right at a line start stays there
+                const char *p = std::max(data + size * i / chunk_count, starts[i - 1]);
+                starts[i] = skip_line(p - 1, data + size);
+            }
+
+            chunks.resize(chunk_count);
+            auto parse_chunk = [&](int i)
+            {
+                obj_chunk_t &chunk = chunks[i];
+                chunk.vertices.clear();
+                chunk.uvs.clear();
+                chunk.normals.clear();
+                chunk.corners.clear();
+                chunk.polygons.clear();
+
+                // a rough guess from the usual line lengths, so the lists don't have to grow much
+                size_t bytes = starts[i + 1] - starts[i];
+                chunk.vertices.reserve(bytes / 100);
+                chunk.uvs.reserve(bytes / 100);
+                chunk.normals.reserve(bytes / 100);
+                chunk.corners.reserve(bytes / 40);
+
+                parse(starts[i], starts[i + 1], chunk);
+            };
+
+            if (chunk_count == 1)
+                parse_chunk(0);
+            else
+                workers->parallel_for(chunk_count, parse_chunk);
+        }
+
+        // joins the chunks into the loader's lists. the running totals before every chunk say where its entries go
+        // and what its relative indices are relative to.
+        void merge_chunks()
+        {
+            size_t chunk_count = chunks.size();
+
+            struct offsets_t
+            {
+                size_t vertices, uvs, normals, corners, polygons;
+            };
+            vector<offsets_t> offsets(chunk_count + 1);
+            offsets[0] = {};
+            for (size_t i = 0; i < chunk_count; i++)
+            {
+                const obj_chunk_t &c = chunks[i];
+                offsets[i + 1] = {offsets[i].vertices + c.vertices.size(), offsets[i].uvs + c.uvs.size(),
+                                  offsets[i].normals + c.normals.size(), offsets[i].corners + c.corners.size(),
+                                  offsets[i].polygons + c.polygons.size()};
+            }
+
+            vertices.resize(offsets[chunk_count].vertices);
+            uvs.resize(offsets[chunk_count].uvs);
+            normals.resize(offsets[chunk_count].normals);
+            corners.resize(offsets[chunk_count].corners);
+            polygons.resize(offsets[chunk_count].polygons);
+
+            auto fix_up = [](int index, size_t offset)
+            {
+                return index < -relative_index_bias / 2 ? index + relative_index_bias + (int)offset : index;
+            };
+
+            auto merge_chunk = [&](int i)
+            {
+                const obj_chunk_t &c = chunks[i];
+                const offsets_t &o = offsets[i];
+
+                if (!c.vertices.empty())
+                    memcpy(&vertices[o.vertices], c.vertices.data(), c.vertices.size() * sizeof(Vector3));
+                if (!c.uvs.empty())
+                    memcpy(&uvs[o.uvs], c.uvs.data(), c.uvs.size() * sizeof(Vector2));
+                if (!c.normals.empty())
+                    memcpy(&normals[o.normals], c.normals.data(), c.normals.size() * sizeof(Vector3));
 
-                else if (!words[0].compare("vt"))
+                for (size_t k = 0; k < c.corners.size(); k++)
                 {
-                    uvs.push_back(read_vec2(words));
+                    tri_indicies t = c.corners[k];
+                    corners[o.corners + k] = {fix_up(t.p, o.vertices), fix_up(t.uv, o.uvs), fix_up(t.n, o.normals)};
                 }
 
-                else if (!words[0].compare("vn"))
+                for (size_t k = 0; k < c.polygons.size(); k++)
                 {
-                    normals.push_back(read_vec3(words));
+                    polygons[o.polygons + k] = {c.polygons[k].first_corner + o.corners, c.polygons[k].corner_count};
                 }
+            };
+
+            if (chunk_count == 1)
+                merge_chunk(0);
+            else
+                workers->parallel_for((int)chunk_count, merge_chunk);
+        }
+
+        // the corners of a polygon back out of the triangles parse wrote for it
+        void polygon_corners(const obj_polygon_t &polygon, vector<tri_indicies> &out) const
+        {
+            // a record left over from an earlier file would point anywhere into this one's corners
+            assert(polygon.first_corner + 3 * (polygon.corner_count - 2) <= corners.size());
+
+            const tri_indicies *t = &corners[polygon.first_corner];
+            out.clear();
+
+            if (polygon.corner_count == 4)
+            {
+                out.insert(out.end(), {t[0], t[1], t[2], t[4]});
+                return;
+            }
+
+            out.insert(out.end(), {t[0], t[1]});
+            for (uint32_t k = 0; k + 2 < polygon.corner_count; k++)
+            {
+                out.push_back(t[k * 3 + 2]);
+            }
+        }
+
+        // ear clipping in the plane the polygon is most facing. convex polygons keep the triangles parse gave them.
+        // faces that don't have an ear left (they cross themselves or are degenerate) get the rest cut off at any
+        // corner, so every polygon still ends up with corner_count - 2 triangles in its place.
+        void triangulate_polygon(const obj_polygon_t &polygon, vector<tri_indicies> &ring, vector<Vector2> &points,
+                                 vector<uint32_t> &remaining)
+        {
+            polygon_corners(polygon, ring);
+            for (const tri_indicies &c : ring)
+            {
+                if (!is_valid_position(c.p))
+                    return; // the triangles get dropped anyway
+            }
+
+            size_t n = ring.size();
+
+            // newell's normal, its biggest axis is the one to drop
+            Vector3 normal = {};
+            for (size_t i = 0; i < n; i++)
+            {
+                Vector3 a = vertices[ring[i].p];
+                Vector3 b = vertices[ring[(i + 1) % n].p];
+                normal.x += (a.y - b.y) * (a.z + b.z);
+                normal.y += (a.z - b.z) * (a.x + b.x);
+                normal.z += (a.x - b.x) * (a.y + b.y);
+            }
+
+            Vector3 abs_normal = {fabsf(normal.x), fabsf(normal.y), fabsf(normal.z)};
+            int axis = abs_normal.x >= abs_normal.y && abs_normal.x >= abs_normal.z ? 0 : abs_normal.y >= abs_normal.z ? 1 : 2;
+            float facing = axis == 0 ? normal.x : axis == 1 ? normal.y : normal.z;
+            if (facing == 0)
+                return;
+
+            // projected so that the polygon winds counter clockwise
+            points.resize(n);
+            for (size_t i = 0; i < n; i++)
+            {
+                Vector3 v = vertices[ring[i].p];
+                Vector2 q = axis == 0 ? Vector2{v.y, v.z} : axis == 1 ? Vector2{v.z, v.x} : Vector2{v.x, v.y};
+                if (facing < 0)
+                    q.x = -q.x;
+                points[i] = q;
+            }
 
-                else if (!words[0].compare("f"))
+            auto cross = [&](uint32_t a, uint32_t b, uint32_t c)
+            {
+                Vector2 pa = points[a], pb = points[b], pc = points[c];
+                return (pb.x - pa.x) * (pc.y - pa.y) - (pb.y - pa.y) * (pc.x - pa.x);
+            };
+
+            bool convex = true;
+            for (size_t i = 0; i < n && convex; i++)
+            {
+                convex = cross((uint32_t)i, (uint32_t)((i + 1) % n), (uint32_t)((i + 2) % n)) >= 0;
+            }
+            if (convex)
+                return;
+
+            remaining.resize(n);
+            for (size_t i = 0; i < n; i++)
+            {
+                remaining[i] = (uint32_t)i;
+            }
+
+            tri_indicies *out = &corners[polygon.first_corner];
+            auto clip = [&](size_t i)
+            {
+                size_t count = remaining.size();
+                uint32_t a = remaining[(i + count - 1) % count], b = remaining[i], c = remaining[(i + 1) % count];
+                *out++ = ring[a];
+                *out++ = ring[b];
+                *out++ = ring[c];
+                remaining.erase(remaining.begin() + i);
+            };
+
+            while (remaining.size() > 3)
+            {
+                size_t count = remaining.size();
+                size_t ear = count;
+
+                for (size_t i = 0; i < count && ear == count; i++)
                 {
-                    for (size_t i = 1; i < words.size(); i++)
+                    uint32_t a = remaining[(i + count - 1) % count], b = remaining[i], c = remaining[(i + 1) % count];
+                    if (cross(a, b, c) <= 0)
+                        continue; // reflex or flat corner
+
+                    // no other corner may be inside the ear
+                    bool empty = true;
+                    for (size_t k = 0; k < count && empty; k++)
                     {
-                        face_serialized_data.push_back(words[i]);
+                        uint32_t v = remaining[k];
+                        if (v == a || v == b || v == c)
+                            continue;
+                        empty = !(cross(a, b, v) >= 0 && cross(b, c, v) >= 0 && cross(c, a, v) >= 0);
                     }
+
+                    if (empty)
+                        ear = i;
                 }
+
+                clip(ear == count ? 0 : ear);
             }
-            file.close();
 
-            for (size_t i = 0; i < face_serialized_data.size(); i += 4)
+            clip(1);
+        }
+
+        void triangulate_polygons()
+        {
+            if (polygons.empty())
+                return;
+
+            // polygons own their corners, so ranges of them can be done at the same time
+            int range_count = (int)std::min(chunks.size(), polygons.size());
+            auto triangulate_range = [&](int r)
             {
-                triangle_t t1;
-                triangle_t t2;
+                vector<tri_indicies> ring;
+                vector<Vector2> points;
+                vector<uint32_t> remaining;
+
+                size_t first = polygons.size() * r / range_count;
+                size_t last = polygons.size() * (r + 1) / range_count;
+                for (size_t i = first; i < last; i++)
+                {
+                    triangulate_polygon(polygons[i], ring, points, remaining);
+                }
+            };
 
-                read_vertex(t1.v1, face_serialized_data[i]);     // read first  vertex of first  triangle
-                read_vertex(t1.v2, face_serialized_data[i + 1]); // read second vertex of first  triangle
-                read_vertex(t1.v3, face_serialized_data[i + 2]); // read third  vertex of first  triangle
-                read_vertex(t2.v1, face_serialized_data[i + 2]); // read first  vertex of second triangle
-                read_vertex(t2.v2, face_serialized_data[i + 3]); // read second vertex of second triangle
-                read_vertex(t2.v3, face_serialized_data[i]);     // read third  vertex of second triangle
+            if (range_count == 1)
+                triangulate_range(0);
+            else
+                workers->parallel_for(range_count, triangulate_range);
+        }
 
-                faces.push_back(t1);
-                faces.push_back(t2);
+        void clear()
+        {
+            vertices.clear();
+            uvs.clear();
+            normals.clear();
+            corners.clear();
+            polygons.clear();
+            vertex_corners.clear();
+            position_first_vertex.clear();
+            next_vertex.clear();
+        }
+
+        static bool read_file(const string &path, vector<char> &data)
+        {
+            std::ifstream file(path, std::ios::binary | std::ios::ate);
+            if (!file)
+                return false;
+
+            std::streamsize size = file.tellg();
+            file.seekg(0);
+
+            data.resize((size_t)size);
+            return (bool)file.read(data.data(), size);
+        }
+
+        // parses the file and builds the mesh with its lods, clusters, streams and bounds
+        mesh_t build_mesh(const string &path)
+        {
+            clear();
+
+            vector<char> data;
+            if (!read_file(path, data))
+                cout << "can't read " << path << endl;
+
+            parse_chunks(data.data(), data.size());
+            merge_chunks();
+            triangulate_polygons();
+
+            mesh_t model_mesh;
+            model_mesh.vertices.reserve(vertices.size());
+            model_mesh.uvs.reserve(vertices.size());
+            model_mesh.normals.reserve(vertices.size());
+            position_first_vertex.assign(vertices.size(), no_vertex);
+
+            // triangles with a corner pointing past the position list are dropped
+            vector<uint32_t> indices;
+            indices.reserve(corners.size());
+            for (size_t i = 0; i + 2 < corners.size(); i += 3)
+            {
+                if (!is_valid_position(corners[i].p) || !is_valid_position(corners[i + 1].p) || !is_valid_position(corners[i + 2].p))
+                    continue;
+
+                indices.push_back(get_vertex(corners[i], model_mesh));
+                indices.push_back(get_vertex(corners[i + 1], model_mesh));
+                indices.push_back(get_vertex(corners[i + 2], model_mesh));
             }
 
-            mesh_t model_mesh = {
-                .vertices = vertices,
-                .uvs = uvs,
-                .normals = normals,
-                .faces = faces};
+            if (normals.empty())
+                model_mesh.normals.clear();
+
+            model_mesh.indices.assign(indices.data(), indices.size(), model_mesh.vertices.size());
+            build_lods(model_mesh); // before the clusters split the vertices up
+            build_clusters(model_mesh);
+            build_position_streams(model_mesh);
+            compute_bounds(model_mesh);
+            return model_mesh;
+        }
+
+    public:
+        // when set the built mesh is written to a cache file next to the obj file (see mesh_cache.h), and later loads
+        // read that instead as long as the obj file doesn't change
+        bool use_mesh_cache = true;
+
+        model_t load_obj_data(const string& path)
+        {
+            mesh_t model_mesh;
+            if (!use_mesh_cache || !load_mesh_cache(path, model_mesh))
+            {
+                model_mesh = build_mesh(path);
+                if (use_mesh_cache && !save_mesh_cache(path, model_mesh))
+                    cout << "can't write the mesh cache of " << path << endl;
+            }
 
             transform_t t = {
                 .position = (Vector3){0, 0, 7},
@@ -132,10 +716,10 @@ namespace ssr
                 .scale = (Vector3){2, 2, 2}};
 
             model_t model = {
-                .mesh = model_mesh,
+                .mesh = std::move(model_mesh),
                 .transform = t};
 
             return model;
         }
     };
-}
\ No newline at end of file
+}
@@ -2,8 +2,17 @@
 
 #include "../include/raylib.h"
 #include "../include/raymath.h"
+#include "bvh.h"
+#include "frame_arena.h"
+#include "simd.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <cstdint>
 #include <filesystem>
 #include <iostream>
+#include <memory>
 #include <vector>
 #include <tuple>
 
@@ -19,6 +28,38 @@ namespace ssr
         int y;
     };
 
+    // pixel rectangle, max values are inclusive
+    struct rect_t
+    {
+        int x_min;
+        int y_min;
+        int x_max;
+        int y_max;
+    };
+
+    // the part of the framebuffer that ndc [-1, 1] is mapped to
+    struct viewport_t
+    {
+        int x;
+        int y;
+        int width;
+        int height;
+    };
+
+    // screen sized buffer of 1/z values, 0 means nothing was drawn there yet
+    using depth_buffer_t = vector<float, simd::aligned_allocator<float, 64>>;
+
+    // one float per vertex, starting on a cache line so the vertex stage can walk it with full vector loads and stores
+    using float_stream_t = vector<float, simd::aligned_allocator<float, 64>>;
+
+    // vertex streams are padded with zeros to a multiple of this, so the vertex stage never needs a scalar tail
+    constexpr size_t vertex_stream_padding = 8;
+
+    size_t padded_vertex_count(size_t count)
+    {
+        return (count + vertex_stream_padding - 1) / vertex_stream_padding * vertex_stream_padding;
+    }
+
     class camera_t
     {
     public:
@@ -81,28 +122,594 @@ namespace ssr
         Vector3 normal;
     };
 
-    struct tri_indicies
+    // the three vertex indices of a face
+    struct triangle_t
     {
-        int p;// position 
-        int uv; // uv coordinates
-        int n; // normals
+        uint32_t v1;
+        uint32_t v2;
+        uint32_t v3;
     };
 
-    struct triangle_t
+    // three vertex indices per face. they are stored in 16 bits when every index fits, 32 bits otherwise.
+    class index_buffer_t
+    {
+    private:
+        vector<uint16_t> indices16;
+        vector<uint32_t> indices32; // only used by meshes with more than 65536 vertices
+
+    public:
+        // takes count indices into a vertex buffer of vertex_count vertices
+        void assign(const uint32_t *indices, size_t count, size_t vertex_count)
+        {
+            indices16.clear();
+            indices32.clear();
+
+            if (vertex_count <= 65536)
+                indices16.assign(indices, indices + count);
+            else
+                indices32.assign(indices, indices + count);
+        }
+
+        // takes count indices that are already 16 bit when is_16bit is set, 32 bit otherwise
+        void assign_packed(const void *indices, size_t count, bool is_16bit)
+        {
+            indices16.clear();
+            indices32.clear();
+
+            if (is_16bit)
+                indices16.assign((const uint16_t *)indices, (const uint16_t *)indices + count);
+            else
+                indices32.assign((const uint32_t *)indices, (const uint32_t *)indices + count);
+        }
+
+        bool is_16bit() const
+        {
+            return indices32.empty();
+        }
+
+        // the indices as they are stored, 2 or 4 bytes each
+        const void *data() const
+        {
+            return is_16bit() ? (const void *)indices16.data() : (const void *)indices32.data();
+        }
+
+        size_t size() const
+        {
+            return indices16.size() + indices32.size();
+        }
+
+        uint32_t operator[](size_t i) const
+        {
+            return is_16bit() ? indices16[i] : indices32[i];
+        }
+
+        triangle_t face(size_t f) const
+        {
+            if (is_16bit())
+                return {indices16[f * 3], indices16[f * 3 + 1], indices16[f * 3 + 2]};
+            return {indices32[f * 3], indices32[f * 3 + 1], indices32[f * 3 + 2]};
+        }
+    };
+
+    // object space bounding volumes of a mesh
+    struct bounds_t
     {
-        tri_indicies v1;
-        tri_indicies v2;
-        tri_indicies v3;
+        Vector3 min;
+        Vector3 max;
+        Vector3 center; // of the bounding sphere
+        float radius = -1; // < 0 until compute_bounds ran
     };
 
+    // a group of neighbouring faces that gets culled as a whole before its vertices are transformed. its faces are
+    // mesh.face(first_face) to mesh.face(first_face + face_count - 1) and they only use the vertices [first_vertex, first_vertex +
+    // vertex_count), vertex_count is a multiple of vertex_stream_padding.
+    struct cluster_t
+    {
+        uint32_t first_face;
+        uint32_t face_count;
+        uint32_t first_vertex;
+        uint32_t vertex_count;
+
+        // bounding sphere
+        Vector3 center;
+        float radius;
+
+        // every face normal is within the cone around cone_axis. cone_cutoff is the sine of the cone's half angle,
+        // or 2 when the normals spread over more than a half sphere and the cone can't be used for culling.
+        Vector3 cone_axis;
+        float cone_cutoff;
+    };
+
+    constexpr size_t max_cluster_faces = 128;
+    constexpr size_t max_cluster_vertices = 128;
+
+    // indexed triangle mesh. vertices, uvs and normals are parallel arrays with one entry per unique combination of
+    // them, so a face corner is a single index and a transformed vertex is shared by every face that uses it.
+    // normals may be empty.
     struct mesh_t
     {
         vector<Vector3> vertices;
         vector<Vector2> uvs;
         vector<Vector3> normals;
-        vector<ssr::triangle_t> faces;
+        index_buffer_t indices;
+
+        // the positions again, split into x, y and z arrays of padded_vertex_count(vertices.size()) entries.
+        // this is what the vertex stage reads. filled by build_position_streams.
+        float_stream_t position_x;
+        float_stream_t position_y;
+        float_stream_t position_z;
+
+        bounds_t bounds;
+
+        vector<cluster_t> clusters; // filled by build_clusters, empty means the mesh is drawn as one piece
+
+        // simplified versions of the mesh, each coarser than the one before (see build_lods). lod_error is how far,
+        // in object space units, the surface of a LOD may be from the full mesh's. it is 0 for the full mesh.
+        vector<mesh_t> lods;
+        float lod_error = 0;
+
+        size_t face_count() const
+        {
+            return indices.size() / 3;
+        }
+
+        triangle_t face(size_t i) const
+        {
+            return indices.face(i);
+        }
     };
 
+    // box around all vertices, and a sphere around the box's center that holds all vertices.
+    // has to be called again whenever mesh.vertices changes.
+    void compute_bounds(mesh_t &mesh)
+    {
+        bounds_t b = {};
+
+        if (mesh.vertices.empty())
+        {
+            b.radius = 0;
+            mesh.bounds = b;
+            return;
+        }
+
+        b.min = mesh.vertices[0];
+        b.max = mesh.vertices[0];
+        for (const Vector3 &v : mesh.vertices)
+        {
+            b.min = Vector3Min(b.min, v);
+            b.max = Vector3Max(b.max, v);
+        }
+
+        b.center = Vector3Scale(Vector3Add(b.min, b.max), 0.5f);
+
+        float radius_sqr = 0;
+        for (const Vector3 &v : mesh.vertices)
+        {
+            radius_sqr = std::max(radius_sqr, Vector3DistanceSqr(v, b.center));
+        }
+        b.radius = sqrtf(radius_sqr);
+
+        mesh.bounds = b;
+    }
+
+    // sphere around the box of the cluster's vertices and the cone around its face normals
+    void compute_cluster_bounds(const mesh_t &mesh, cluster_t &c)
+    {
+        Vector3 min = mesh.vertices[c.first_vertex];
+        Vector3 max = min;
+        for (uint32_t i = c.first_vertex; i < c.first_vertex + c.vertex_count; i++)
+        {
+            min = Vector3Min(min, mesh.vertices[i]);
+            max = Vector3Max(max, mesh.vertices[i]);
+        }
+
+        c.center = Vector3Scale(Vector3Add(min, max), 0.5f);
+        float radius_sqr = 0;
+        for (uint32_t i = c.first_vertex; i < c.first_vertex + c.vertex_count; i++)
+        {
+            radius_sqr = std::max(radius_sqr, Vector3DistanceSqr(mesh.vertices[i], c.center));
+        }
+        c.radius = sqrtf(radius_sqr);
+
+        // same winding as is_back_face, so the normals point to the front side
+        auto face_normal = [&](const triangle_t &f)
+        {
+            Vector3 a = mesh.vertices[f.v1];
+            Vector3 b = mesh.vertices[f.v2];
+            Vector3 c = mesh.vertices[f.v3];
+            return Vector3CrossProduct(Vector3Subtract(b, a), Vector3Subtract(c, a));
+        };
+
+        Vector3 axis = {0, 0, 0};
+        for (uint32_t i = c.first_face; i < c.first_face + c.face_count; i++)
+        {
+            Vector3 n = face_normal(mesh.face(i));
+            if (Vector3LengthSqr(n) > 0)
+                axis = Vector3Add(axis, Vector3Normalize(n));
+        }
+
+        c.cone_axis = Vector3Normalize(axis);
+        c.cone_cutoff = 2;
+
+        if (Vector3LengthSqr(axis) == 0)
+            return;
+
+        float min_dot = 1;
+        for (uint32_t i = c.first_face; i < c.first_face + c.face_count; i++)
+        {
+            Vector3 n = face_normal(mesh.face(i));
+            if (Vector3LengthSqr(n) > 0)
+                min_dot = std::min(min_dot, Vector3DotProduct(Vector3Normalize(n), c.cone_axis));
+        }
+
+        if (min_dot > 0)
+            c.cone_cutoff = sqrtf(1 - min_dot * min_dot);
+    }
+
+    // face order for a post-transform vertex cache of cache_size vertices (tipsify, Sander et al. 2007). faces are
+    // emitted in fans around one vertex at a time, and the next fan vertex is a neighbour that is still in the cache.
+    vector<uint32_t> tipsify_face_order(const uint32_t *indices, size_t face_count, size_t vertex_count, int cache_size)
+    {
+        vector<uint32_t> first_vertex_face(vertex_count + 1, 0);
+        for (size_t i = 0; i < face_count * 3; i++)
+        {
+            first_vertex_face[indices[i] + 1]++;
+        }
+        for (size_t i = 0; i < vertex_count; i++)
+        {
+            first_vertex_face[i + 1] += first_vertex_face[i];
+        }
+
+        vector<uint32_t> vertex_faces(face_count * 3);
+        vector<uint32_t> fill(first_vertex_face.begin(), first_vertex_face.end() - 1);
+        for (size_t i = 0; i < face_count * 3; i++)
+        {
+            vertex_faces[fill[indices[i]]++] = (uint32_t)(i / 3);
+        }
+
+        vector<int> live(vertex_count); // faces not emitted yet
+        for (size_t v = 0; v < vertex_count; v++)
+        {
+            live[v] = (int)(first_vertex_face[v + 1] - first_vertex_face[v]);
+        }
+
+        vector<int> cache_time(vertex_count, 0);
+        vector<uint8_t> emitted(face_count, 0);
+        vector<uint32_t> dead_end;   // recently used vertices, to restart from when a fan runs out of neighbours
+        vector<uint32_t> candidates; // vertices of the last fan
+        vector<uint32_t> order;
+        order.reserve(face_count);
+
+        int time = cache_size + 1;
+        size_t cursor = 0;
+        int64_t fan = 0;
+
+        while (fan >= 0)
+        {
+            candidates.clear();
+
+            for (uint32_t j = first_vertex_face[fan]; j < first_vertex_face[fan + 1]; j++)
+            {
+                uint32_t f = vertex_faces[j];
+                if (emitted[f])
+                    continue;
+
+                for (int k = 0; k < 3; k++)
+                {
+                    uint32_t v = indices[f * 3 + k];
+                    dead_end.push_back(v);
+                    candidates.push_back(v);
+                    live[v]--;
+
+                    if (time - cache_time[v] > cache_size)
+                        cache_time[v] = time++;
+                }
+
+                emitted[f] = 1;
+                order.push_back(f);
+            }
+
+            // the neighbour that stays in the cache for the longest while its remaining faces get emitted
+            fan = -1;
+            int best = -1;
+            for (uint32_t v : candidates)
+            {
+                if (live[v] <= 0)
+                    continue;
+
+                int priority = 0;
+                if (time - cache_time[v] + 2 * live[v] <= cache_size)
+                    priority = time - cache_time[v];
+
+                if (priority > best)
+                {
+                    best = priority;
+                    fan = v;
+                }
+            }
+
+            if (fan >= 0)
+                continue;
+
+            while (!dead_end.empty() && fan < 0)
+            {
+                uint32_t v = dead_end.back();
+                dead_end.pop_back();
+                if (live[v] > 0)
+                    fan = v;
+            }
+
+            while (fan < 0 && cursor < vertex_count)
+            {
+                if (live[cursor] > 0)
+                    fan = (int64_t)cursor;
+                cursor++;
+            }
+        }
+
+        return order;
+    }
+
+    // reorders a clustered mesh for drawing. the faces of every cluster are put in tipsify order and the cluster's
+    // vertices renumbered in the order those faces first use them, so the setup stage walks the transformed vertices
+    // mostly forward. then the clusters themselves are sorted so that the ones out on the surface and facing away
+    // from the mesh's center come first (Sander et al.'s view independent overdraw order): from most directions they
+    // are the ones in front, and drawing them first lets the depth test reject more of what is behind them.
+    void optimize_cluster_order(mesh_t &mesh)
+    {
+        if (mesh.clusters.empty())
+            return;
+
+        constexpr int vertex_cache_size = 16;
+
+        Vector3 min = mesh.vertices[0];
+        Vector3 max = min;
+        for (const Vector3 &v : mesh.vertices)
+        {
+            min = Vector3Min(min, v);
+            max = Vector3Max(max, v);
+        }
+        Vector3 center = Vector3Scale(Vector3Add(min, max), 0.5f);
+
+        vector<float> outwardness(mesh.clusters.size());
+        vector<uint32_t> cluster_order(mesh.clusters.size());
+        for (size_t i = 0; i < mesh.clusters.size(); i++)
+        {
+            const cluster_t &c = mesh.clusters[i];
+            outwardness[i] = Vector3DotProduct(Vector3Subtract(c.center, center), c.cone_axis);
+            cluster_order[i] = (uint32_t)i;
+        }
+        std::stable_sort(cluster_order.begin(), cluster_order.end(), [&](uint32_t a, uint32_t b)
+                         { return outwardness[a] > outwardness[b]; });
+
+        bool has_normals = !mesh.normals.empty();
+        size_t vertex_count = mesh.vertices.size();
+
+        vector<Vector3> vertices(vertex_count);
+        vector<Vector2> uvs(vertex_count);
+        vector<Vector3> normals(has_normals ? vertex_count : 0);
+        vector<uint32_t> indices;
+        vector<cluster_t> clusters;
+        indices.reserve(mesh.indices.size());
+        clusters.reserve(mesh.clusters.size());
+
+        vector<uint32_t> local;
+        vector<int> remap;
+
+        size_t next_vertex = 0;
+        for (uint32_t ci : cluster_order)
+        {
+            cluster_t c = mesh.clusters[ci];
+
+            local.resize(c.face_count * 3);
+            for (uint32_t i = 0; i < c.face_count * 3; i++)
+            {
+                local[i] = mesh.indices[c.first_face * 3 + i] - c.first_vertex;
+            }
+
+            vector<uint32_t> face_order = tipsify_face_order(local.data(), c.face_count, c.vertex_count, vertex_cache_size);
+
+            uint32_t old_first_vertex = c.first_vertex;
+            c.first_face = (uint32_t)(indices.size() / 3);
+            c.first_vertex = (uint32_t)next_vertex;
+
+            remap.assign(c.vertex_count, -1);
+            int used = 0;
+            for (uint32_t f : face_order)
+            {
+                for (int k = 0; k < 3; k++)
+                {
+                    uint32_t v = local[f * 3 + k];
+                    if (remap[v] < 0)
+                        remap[v] = used++;
+                    indices.push_back(c.first_vertex + remap[v]);
+                }
+            }
+
+            // padding copies nobody uses stay at the end
+            for (uint32_t v = 0; v < c.vertex_count; v++)
+            {
+                if (remap[v] < 0)
+                    remap[v] = used++;
+
+                size_t from = old_first_vertex + v;
+                size_t to = c.first_vertex + remap[v];
+                vertices[to] = mesh.vertices[from];
+                uvs[to] = mesh.uvs[from];
+                if (has_normals)
+                    normals[to] = mesh.normals[from];
+            }
+
+            next_vertex += c.vertex_count;
+            clusters.push_back(c);
+        }
+
+        mesh.vertices = std::move(vertices);
+        mesh.uvs = std::move(uvs);
+        mesh.normals = std::move(normals);
+        mesh.indices.assign(indices.data(), indices.size(), mesh.vertices.size());
+        mesh.clusters = std::move(clusters);
+    }
+
+    // splits the mesh into clusters of at most max_cluster_faces faces and max_cluster_vertices vertices. a cluster is
+    // grown from a seed face over faces that share a vertex with it, so it stays a connected patch of the surface.
+    // faces are reordered by cluster and every cluster gets its own copy of the vertices it uses, padded to a multiple
+    // of vertex_stream_padding, so the vertex stage can transform a cluster's vertices as one contiguous range.
+    // the result goes through optimize_cluster_order. build_position_streams and compute_bounds have to run after this.
+    void build_clusters(mesh_t &mesh)
+    {
+        size_t face_count = mesh.face_count();
+        size_t vertex_count = mesh.vertices.size();
+        bool has_normals = !mesh.normals.empty();
+
+        mesh.clusters.clear();
+        if (face_count == 0)
+            return;
+
+        // faces around every vertex
+        vector<uint32_t> first_vertex_face(vertex_count + 1, 0);
+        for (size_t i = 0; i < mesh.indices.size(); i++)
+        {
+            first_vertex_face[mesh.indices[i] + 1]++;
+        }
+        for (size_t i = 0; i < vertex_count; i++)
+        {
+            first_vertex_face[i + 1] += first_vertex_face[i];
+        }
+
+        vector<uint32_t> vertex_faces(face_count * 3);
+        vector<uint32_t> fill(first_vertex_face.begin(), first_vertex_face.end() - 1);
+        for (size_t i = 0; i < mesh.indices.size(); i++)
+        {
+            vertex_faces[fill[mesh.indices[i]]++] = (uint32_t)(i / 3);
+        }
+
+        vector<Vector3> vertices;
+        vector<Vector2> uvs;
+        vector<Vector3> normals;
+        vector<uint32_t> indices;
+        vertices.reserve(vertex_count + vertex_count / 4);
+        uvs.reserve(vertex_count + vertex_count / 4);
+        if (has_normals)
+            normals.reserve(vertex_count + vertex_count / 4);
+        indices.reserve(face_count * 3);
+
+        vector<uint8_t> assigned(face_count, 0);
+        vector<int> cluster_index(vertex_count, -1); // position in the current cluster's vertex range, -1 when not in it
+        vector<uint32_t> cluster_vertices;
+        vector<uint32_t> queue;
+
+        size_t seed = 0;
+        for (;;)
+        {
+            while (seed < face_count && assigned[seed])
+                seed++;
+            if (seed == face_count)
+                break;
+
+            cluster_t c = {};
+            c.first_face = (uint32_t)(indices.size() / 3);
+            c.first_vertex = (uint32_t)vertices.size();
+
+            cluster_vertices.clear();
+            queue.clear();
+            queue.push_back((uint32_t)seed);
+
+            for (size_t q = 0; q < queue.size() && c.face_count < max_cluster_faces; q++)
+            {
+                uint32_t face_index = queue[q];
+                if (assigned[face_index])
+                    continue;
+
+                triangle_t f = mesh.face(face_index);
+                uint32_t corners[3] = {f.v1, f.v2, f.v3};
+
+                size_t new_vertices = 0;
+                for (int i = 0; i < 3; i++)
+                {
+                    bool repeated = (i > 0 && corners[i] == corners[0]) || (i > 1 && corners[i] == corners[1]);
+                    if (cluster_index[corners[i]] < 0 && !repeated)
+                        new_vertices++;
+                }
+                if (cluster_vertices.size() + new_vertices > max_cluster_vertices)
+                    continue;
+
+                for (int i = 0; i < 3; i++)
+                {
+                    if (cluster_index[corners[i]] < 0)
+                    {
+                        cluster_index[corners[i]] = (int)cluster_vertices.size();
+                        cluster_vertices.push_back(corners[i]);
+                    }
+
+                    for (uint32_t j = first_vertex_face[corners[i]]; j < first_vertex_face[corners[i] + 1]; j++)
+                    {
+                        if (!assigned[vertex_faces[j]])
+                            queue.push_back(vertex_faces[j]);
+                    }
+                }
+
+                for (int i = 0; i < 3; i++)
+                {
+                    indices.push_back(c.first_vertex + cluster_index[corners[i]]);
+                }
+
+                assigned[face_index] = 1;
+                c.face_count++;
+            }
+
+            for (uint32_t v : cluster_vertices)
+            {
+                vertices.push_back(mesh.vertices[v]);
+                uvs.push_back(mesh.uvs[v]);
+                if (has_normals)
+                    normals.push_back(mesh.normals[v]);
+                cluster_index[v] = -1;
+            }
+
+            // padding repeats the last vertex, so it doesn't change the bounds
+            while ((vertices.size() - c.first_vertex) % vertex_stream_padding != 0)
+            {
+                vertices.push_back(vertices.back());
+                uvs.push_back(uvs.back());
+                if (has_normals)
+                    normals.push_back(normals.back());
+            }
+
+            c.vertex_count = (uint32_t)(vertices.size() - c.first_vertex);
+            mesh.clusters.push_back(c);
+        }
+
+        mesh.vertices = std::move(vertices);
+        mesh.uvs = std::move(uvs);
+        mesh.normals = std::move(normals);
+        mesh.indices.assign(indices.data(), indices.size(), mesh.vertices.size());
+
+        for (cluster_t &c : mesh.clusters)
+        {
+            compute_cluster_bounds(mesh, c);
+        }
+
+        optimize_cluster_order(mesh);
+    }
+
+    // has to be called again whenever mesh.vertices changes
+    void build_position_streams(mesh_t &mesh)
+    {
+        size_t padded = padded_vertex_count(mesh.vertices.size());
+
+        mesh.position_x.assign(padded, 0.0f);
+        mesh.position_y.assign(padded, 0.0f);
+        mesh.position_z.assign(padded, 0.0f);
+
+        for (size_t i = 0; i < mesh.vertices.size(); i++)
+        {
+            mesh.position_x[i] = mesh.vertices[i].x;
+            mesh.position_y[i] = mesh.vertices[i].y;
+            mesh.position_z[i] = mesh.vertices[i].z;
+        }
+    }
+
     struct transform_t
     {
         Vector3 position;
@@ -116,14 +723,37 @@ namespace ssr
         transform_t transform;
     };
 
+    // colors of an image kept in memory for the rasterizer to sample
+    struct texture_t
+    {
+        int width = 0;
+        int height = 0;
+        Color *texels = nullptr;
+    };
+
+    texture_t load_texture(const std::string &path)
+    {
+        Image image = LoadImage(path.c_str());
+        texture_t texture = {image.width, image.height, LoadImageColors(image)};
+        UnloadImage(image);
+
+        return texture;
+    }
+
+    void unload_texture(texture_t &texture)
+    {
+        if (texture.texels)
+            UnloadImageColors(texture.texels);
+        texture = {};
+    }
+
 #pragma endregion
 
 #pragma region transformations
 
-    Matrix get_projection_matrix(const camera_t &cam)
+    // a is the height / width ratio of the viewport
+    Matrix get_projection_matrix(const camera_t &cam, float a)
     {
-        float a = (float)GetScreenHeight() / (float)GetScreenWidth();
-        ;
         float fov = cam.fov * DEG2RAD;
         float f = 1.0f / (tanf(fov / 2.0f));
         float z1 = cam.z_far / (cam.z_far - cam.z_near);
@@ -159,29 +789,37 @@ namespace ssr
         return result;
     }
 
-    Vector3 transform_to_world_space(Vector3 v, const transform_t &tr)
+    // object space -> world space
+    Matrix get_model_matrix(const transform_t &tr)
     {
         Matrix s = MatrixScale(tr.scale.x, tr.scale.y, tr.scale.z);
         Matrix r = MatrixRotateZYX(tr.rotation);
         Matrix t = MatrixTranslate(tr.position.x, tr.position.y, tr.position.z);
 
-        Matrix transform_matrix = MatrixMultiply(MatrixMultiply(s, r), t);
-
-        return Vector3Transform(v, transform_matrix);
+        return MatrixMultiply(MatrixMultiply(s, r), t);
     }
 
-    Vector3 transform_to_camera_space(Vector3 v_world, const camera_t &cam)
+    // box around the box [min, max] after it went through m
+    aabb_t transform_box(Vector3 min, Vector3 max, const Matrix &m)
     {
-        Vector3 v_translated = Vector3Subtract(v_world, cam.position);
+        Vector3 center = Vector3Transform(Vector3Scale(Vector3Add(min, max), 0.5f), m);
+        Vector3 e = Vector3Scale(Vector3Subtract(max, min), 0.5f);
 
-        Vector3 v_camera = Vector3Transform(v_translated, MatrixInvert(MatrixRotateZYX(cam.rot_in_rad)));
+        Vector3 extent = {
+            fabsf(m.m0) * e.x + fabsf(m.m4) * e.y + fabsf(m.m8) * e.z,
+            fabsf(m.m1) * e.x + fabsf(m.m5) * e.y + fabsf(m.m9) * e.z,
+            fabsf(m.m2) * e.x + fabsf(m.m6) * e.y + fabsf(m.m10) * e.z};
 
-        return v_camera;
+        return {Vector3Subtract(center, extent), Vector3Add(center, extent)};
     }
 
-    Vector4 apply_projection_matrix(Vector3 v, camera_t cam)
+    // world space -> camera space. the inverse of a rotation is its transpose.
+    Matrix get_view_matrix(const camera_t &cam)
     {
-        return mul_v3_mat(v, get_projection_matrix(cam));
+        Matrix t = MatrixTranslate(-cam.position.x, -cam.position.y, -cam.position.z);
+        Matrix r = MatrixTranspose(MatrixRotateZYX(cam.rot_in_rad));
+
+        return MatrixMultiply(t, r);
     }
 
     Vector3 apply_perspective_division(Vector4 v)
@@ -195,48 +833,637 @@ namespace ssr
         return result;
     }
 
-    Vector2 map_ndc_to_screen(Vector3 v_ndc)
+    Vector2 map_ndc_to_screen(Vector3 v_ndc, const viewport_t &vp)
     {
         // Scale from [-1, 1] to [0, 1];
         float screen_x = (v_ndc.x + 1) / 2;
         float screen_y = (1 - v_ndc.y) / 2; // Flip Y-axis
 
-        // Scale to screen dimensions
-        screen_x *= GetScreenWidth();
-        screen_y *= GetScreenHeight();
+        // Scale to viewport dimensions
+        screen_x = vp.x + screen_x * vp.width;
+        screen_y = vp.y + screen_y * vp.height;
 
         return {screen_x, screen_y};
     }
 
 #pragma endregion
 
-    class Renderer
+#pragma region scene
+
+    using mesh_handle_t = uint32_t;
+    using texture_handle_t = uint32_t;
+    using instance_handle_t = uint32_t;
+
+    // instances without a texture of their own are drawn with the renderer's default texture
+    constexpr texture_handle_t no_texture = UINT32_MAX;
+
+    // one placement of a mesh in the scene. it only refers to its mesh and texture, so it is cheap to have many of
+    // them. its transform lives in the scene's transform array under the same handle.
+    struct instance_t
     {
-    private:
-        Image model_texture = {};
-        Color *model_tex_colors = {};
+        mesh_handle_t mesh;
+        texture_handle_t texture;
+        bool occluder = false;
+    };
 
-    public:
-        std::string get_full_path(const std::string &relative_path_str)
+    // everything that gets drawn, kept alive across frames. meshes and textures are stored once and referenced by
+    // handle from any number of instances. the renderer reads all of it in place, nothing is copied per frame.
+    // instance transforms are kept in one contiguous array, and the renderer runs the vertex stage of neighbouring
+    // instances of the same mesh as one batch, so instanced meshes should be added with add_instances.
+    class scene_t
+    {
+    private:
+        vector<mesh_t> meshes;
+        vector<texture_t> textures;
+        vector<instance_t> instances;
+        vector<transform_t> transforms; // one per instance
+        vector<uint32_t> occluders;     // handles of the instances flagged as occluders
+
+        // world space boxes of the instances and the hierarchy over them. get_instance_bvh brings both up to date
+        // when it is asked for them: a full build after instances were added, otherwise a refit of the moved ones.
+        mutable vector<aabb_t> instance_boxes;
+        mutable bvh_t instance_bvh;
+        mutable bool bvh_needs_build = true;
+        mutable vector<uint32_t> moved_instances;
+        mutable vector<uint8_t> instance_moved;
+
+        static constexpr size_t min_rebuild_instances = 64;
+
+        aabb_t instance_box(size_t i) const
         {
-            namespace fs = std::filesystem;
-
-            fs::path current_path = fs::current_path();
-            fs::path relative_path = relative_path_str;
-            fs::path full_path = current_path / relative_path;
-            
-            return full_path.string();
+            const bounds_t &b = meshes[instances[i].mesh].bounds;
+            return transform_box(b.min, b.max, get_model_matrix(transforms[i]));
         }
 
-        Renderer(std::string path_to_texture)
+        // fills in whatever the renderer needs and the mesh doesn't have yet
+        static void prepare_mesh(mesh_t &mesh)
         {
-            model_texture = LoadImage(get_full_path(path_to_texture).c_str());
-            model_tex_colors = LoadImageColors(model_texture);
+            if (mesh.clusters.empty())
+            {
+                build_clusters(mesh);
+                build_position_streams(mesh);
+                compute_bounds(mesh);
+            }
+            if (mesh.position_x.size() != padded_vertex_count(mesh.vertices.size()))
+                build_position_streams(mesh);
+            if (mesh.bounds.radius < 0)
+                compute_bounds(mesh);
+        }
+
+    public:
+        scene_t() = default;
+
+        ~scene_t()
+        {
+            for (texture_t &texture : textures)
+            {
+                unload_texture(texture);
+            }
+        }
+
+        scene_t(const scene_t &) = delete;
+        scene_t &operator=(const scene_t &) = delete;
+
+        // takes the mesh over, pass it with std::move to avoid a copy
+        mesh_handle_t add_mesh(mesh_t mesh)
+        {
+            prepare_mesh(mesh);
+            for (mesh_t& lod : mesh.lods)
+            {
+                prepare_mesh(lod);
+            }
+
+            meshes.push_back(std::move(mesh));
+            return (mesh_handle_t)(meshes.size() - 1);
+        }
+
+        texture_handle_t load_texture(const std::string &path)
+        {
+            textures.push_back(ssr::load_texture(path));
+            return (texture_handle_t)(textures.size() - 1);
+        }
+
+        // occluders are drawn into the renderer's low resolution occlusion buffer before anything else. pick a few big
+        // meshes that hide a lot behind them, like walls, floors and buildings.
+        void set_occluder(instance_handle_t handle, bool occluder)
+        {
+            if (instances[handle].occluder == occluder)
+                return;
+
+            instances[handle].occluder = occluder;
+
+            if (occluder)
+                occluders.push_back(handle);
+            else
+                occluders.erase(std::find(occluders.begin(), occluders.end(), handle));
+        }
+
+        const vector<uint32_t> &get_occluders() const
+        {
+            return occluders;
+        }
+
+        instance_handle_t add_instance(mesh_handle_t mesh, const transform_t &transform, texture_handle_t texture = no_texture)
+        {
+            return add_instances(mesh, &transform, 1, texture);
+        }
+
+        // instanced draw: count copies of one mesh with their own transforms. returns the handle of the first
+        // instance, the others follow it in order.
+        instance_handle_t add_instances(mesh_handle_t mesh, const transform_t *instance_transforms, size_t count, texture_handle_t texture = no_texture)
+        {
+            instance_handle_t first = (instance_handle_t)instances.size();
+
+            instances.insert(instances.end(), count, {mesh, texture, false});
+            transforms.insert(transforms.end(), instance_transforms, instance_transforms + count);
+            instance_moved.resize(instances.size(), 0);
+            bvh_needs_build = true;
+
+            return first;
+        }
+
+        // the instance counts as moved as soon as its transform is asked for this way
+        transform_t &transform(instance_handle_t handle)
+        {
+            if (!instance_moved[handle])
+            {
+                instance_moved[handle] = 1;
+                moved_instances.push_back(handle);
+            }
+
+            return transforms[handle];
+        }
+
+        // world space box of an instance as of the last get_instance_bvh call
+        const aabb_t &get_instance_box(instance_handle_t handle) const
+        {
+            return instance_boxes[handle];
+        }
+
+        // hierarchy over the world space boxes of all instances, items are instance handles
+        const bvh_t &get_instance_bvh() const
+        {
+            // refitting lots of moved instances costs about as much as a build and gives a worse tree. small scenes
+            // are always refit, their tree is too small for its quality to matter.
+            if (instances.size() >= min_rebuild_instances && moved_instances.size() > instances.size() / 4)
+                bvh_needs_build = true;
+
+            if (bvh_needs_build)
+            {
+                instance_boxes.resize(instances.size());
+                for (size_t i = 0; i < instances.size(); i++)
+                {
+                    instance_boxes[i] = instance_box(i);
+                }
+
+                instance_bvh.build(instance_boxes.data(), instance_boxes.size());
+                bvh_needs_build = false;
+            }
+            else if (!moved_instances.empty())
+            {
+                for (uint32_t i : moved_instances)
+                {
+                    instance_boxes[i] = instance_box(i);
+                }
+
+                instance_bvh.refit(instance_boxes.data(), moved_instances.data(), moved_instances.size());
+            }
+
+            for (uint32_t i : moved_instances)
+            {
+                instance_moved[i] = 0;
+            }
+            moved_instances.clear();
+
+            return instance_bvh;
+        }
+
+        const vector<instance_t> &get_instances() const
+        {
+            return instances;
+        }
+
+        const vector<transform_t> &get_transforms() const
+        {
+            return transforms;
+        }
+
+        const mesh_t &mesh(mesh_handle_t handle) const
+        {
+            return meshes[handle];
+        }
+
+        // null for no_texture
+        const texture_t *texture(texture_handle_t handle) const
+        {
+            return handle == no_texture ? nullptr : &textures[handle];
+        }
+    };
+
+#pragma endregion
+
+#pragma region clipping
+
+    // outcode bits, a bit is set when a clip space vertex is on the outer side of that plane.
+    // the first six are the view frustum, the guard band planes lie further out in x and y.
+    enum clip_bits : uint16_t
+    {
+        CLIP_NEAR = 1 << 0,
+        CLIP_FAR = 1 << 1,
+        CLIP_LEFT = 1 << 2,
+        CLIP_RIGHT = 1 << 3,
+        CLIP_BOTTOM = 1 << 4,
+        CLIP_TOP = 1 << 5,
+        CLIP_GUARD_LEFT = 1 << 6,
+        CLIP_GUARD_RIGHT = 1 << 7,
+        CLIP_GUARD_BOTTOM = 1 << 8,
+        CLIP_GUARD_TOP = 1 << 9,
+
+        CLIP_FRUSTUM = CLIP_NEAR | CLIP_FAR | CLIP_LEFT | CLIP_RIGHT | CLIP_BOTTOM | CLIP_TOP,
+        // planes a triangle actually gets cut against. anything that is only outside the frustum in x/y but
+        // inside the guard band is left to the rasterizer, which clamps its bounding box to the screen.
+        CLIP_NEEDS_CUT = CLIP_NEAR | CLIP_FAR | CLIP_GUARD_LEFT | CLIP_GUARD_RIGHT | CLIP_GUARD_BOTTOM | CLIP_GUARD_TOP,
+    };
+
+    // screen positions stay within +-guard_band_pixels, which keeps the products in the integer edge functions
+    // far away from overflowing.
+    constexpr float guard_band_pixels = 8192.0f;
+
+    // x and y extent of the guard band in ndc units for the given viewport
+    Vector2 get_guard_band(const viewport_t &vp)
+    {
+        return {2.0f * guard_band_pixels / vp.width - 1.0f, 2.0f * guard_band_pixels / vp.height - 1.0f};
+    }
+
+    // the projection matrix maps z_near to z = 0 and z_far to z = w
+    uint16_t compute_outcode(Vector4 v, Vector2 guard)
+    {
+        uint16_t code = 0;
+
+        if (v.z < 0)
+            code |= CLIP_NEAR;
+        if (v.z > v.w)
+            code |= CLIP_FAR;
+        if (v.x < -v.w)
+            code |= CLIP_LEFT;
+        if (v.x > v.w)
+            code |= CLIP_RIGHT;
+        if (v.y < -v.w)
+            code |= CLIP_BOTTOM;
+        if (v.y > v.w)
+            code |= CLIP_TOP;
+        if (v.x < -guard.x * v.w)
+            code |= CLIP_GUARD_LEFT;
+        if (v.x > guard.x * v.w)
+            code |= CLIP_GUARD_RIGHT;
+        if (v.y < -guard.y * v.w)
+            code |= CLIP_GUARD_BOTTOM;
+        if (v.y > guard.y * v.w)
+            code |= CLIP_GUARD_TOP;
+
+        return code;
+    }
+
+    // the six frustum planes in the space a model-view-projection matrix starts from, so object space bounds can be
+    // tested against them as they are. a point p is inside a plane when dot(plane.xyz, p) + plane.w >= 0.
+    struct frustum_t
+    {
+        Vector4 planes[6];
+    };
+
+    // the planes are the CLIP_FRUSTUM inequalities (0 <= z <= w, -w <= x <= w, -w <= y <= w) written out with the
+    // rows of the matrix and scaled to unit normals, so plane distances come out in object space units.
+    frustum_t get_frustum(const Matrix &m)
+    {
+        Vector4 x = {m.m0, m.m4, m.m8, m.m12};
+        Vector4 y = {m.m1, m.m5, m.m9, m.m13};
+        Vector4 z = {m.m2, m.m6, m.m10, m.m14};
+        Vector4 w = {m.m3, m.m7, m.m11, m.m15};
+
+        frustum_t f = {{
+            z,                                            // near
+            {w.x - z.x, w.y - z.y, w.z - z.z, w.w - z.w}, // far
+            {w.x + x.x, w.y + x.y, w.z + x.z, w.w + x.w}, // left
+            {w.x - x.x, w.y - x.y, w.z - x.z, w.w - x.w}, // right
+            {w.x + y.x, w.y + y.y, w.z + y.z, w.w + y.w}, // bottom
+            {w.x - y.x, w.y - y.y, w.z - y.z, w.w - y.w}, // top
+        }};
+
+        for (Vector4 &p : f.planes)
+        {
+            float length = sqrtf(p.x * p.x + p.y * p.y + p.z * p.z);
+            if (length > 0)
+                p = {p.x / length, p.y / length, p.z / length, p.w / length};
+        }
+
+        return f;
+    }
+
+    // BVH_OUTSIDE when the box is completely outside one of the planes, BVH_INSIDE when it is inside all of them
+    bvh_test_t classify_box(const frustum_t &f, const aabb_t &box)
+    {
+        bvh_test_t result = BVH_INSIDE;
+
+        for (const Vector4 &p : f.planes)
+        {
+            // the corners furthest along and against the plane normal
+            Vector3 furthest = {p.x >= 0 ? box.max.x : box.min.x, p.y >= 0 ? box.max.y : box.min.y, p.z >= 0 ? box.max.z : box.min.z};
+            Vector3 nearest = {p.x >= 0 ? box.min.x : box.max.x, p.y >= 0 ? box.min.y : box.max.y, p.z >= 0 ? box.min.z : box.max.z};
+
+            if (p.x * furthest.x + p.y * furthest.y + p.z * furthest.z + p.w < 0)
+                return BVH_OUTSIDE;
+            if (p.x * nearest.x + p.y * nearest.y + p.z * nearest.z + p.w < 0)
+                result = BVH_INTERSECTS;
+        }
+
+        return result;
+    }
+
+    bool is_sphere_outside(const frustum_t &f, Vector3 center, float radius)
+    {
+        for (const Vector4 &p : f.planes)
+        {
+            if (p.x * center.x + p.y * center.y + p.z * center.z + p.w < -radius)
+                return true;
+        }
+
+        return false;
+    }
+
+    // true when all eight corners of the box are outside the same frustum plane
+    bool is_box_outside(Vector3 min, Vector3 max, const Matrix &mvp)
+    {
+        uint16_t all = CLIP_FRUSTUM;
+
+        for (int i = 0; i < 8 && all; i++)
+        {
+            Vector3 corner = {i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z};
+            all &= compute_outcode(mul_v3_mat(corner, mvp), {1, 1});
+        }
+
+        return all != 0;
+    }
+
+    // whole mesh culling: the sphere test is cheap and throws out most of what is off screen, the box catches
+    // what the sphere is too loose for. f has to come from mvp.
+    bool is_mesh_outside(const bounds_t &b, const frustum_t &f, const Matrix &mvp)
+    {
+        return is_sphere_outside(f, b.center, b.radius) || is_box_outside(b.min, b.max, mvp);
+    }
+
+    // true when the cluster is outside the frustum, or when cone_test is set and all of its faces point away from
+    // eye. the faces point away when every direction from eye to a point in the cluster's sphere is within 90 degrees
+    // of every normal in its cone. f and eye are in the mesh's object space.
+    bool is_cluster_culled(const cluster_t &c, const frustum_t &f, Vector3 eye, bool cone_test)
+    {
+        if (is_sphere_outside(f, c.center, c.radius))
+            return true;
+
+        if (!cone_test)
+            return false;
+
+        Vector3 to_center = Vector3Subtract(c.center, eye);
+        float distance = Vector3Length(to_center);
+
+        if (distance <= c.radius)
+            return false;
+
+        // dot(to_center / distance, axis) >= cone_cutoff + radius / distance, without the divisions
+        return Vector3DotProduct(to_center, c.cone_axis) >= c.cone_cutoff * distance + c.radius;
+    }
+
+    // polygon corner while it is being clipped
+    struct clip_vertex_t
+    {
+        Vector4 position; // clip space
+        Vector2 uv;
+    };
+
+    Vector4 lerp_v4(Vector4 a, Vector4 b, float t)
+    {
+        return {a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t, a.z + (b.z - a.z) * t, a.w + (b.w - a.w) * t};
+    }
+
+    // a triangle cut by the six clip planes can't end up with more corners than this
+    constexpr int max_clipped_vertices = 9;
+
+    // signed distance to one of the CLIP_NEEDS_CUT planes, >= 0 is inside
+    float clip_plane_distance(const Vector4& v, uint16_t plane, Vector2 guard)
+    {
+        switch (plane)
+        {
+        case CLIP_NEAR:
+            return v.z;
+        case CLIP_FAR:
+            return v.w - v.z;
+        case CLIP_GUARD_LEFT:
+            return v.x + guard.x * v.w;
+        case CLIP_GUARD_RIGHT:
+            return guard.x * v.w - v.x;
+        case CLIP_GUARD_BOTTOM:
+            return v.y + guard.y * v.w;
+        default:
+            return guard.y * v.w - v.y;
+        }
+    }
+
+    // one Sutherland-Hodgman pass: keeps the part of the polygon in[0..count) on the inner side of plane.
+    // returns the number of corners written to out.
+    int clip_polygon(const clip_vertex_t *in, int count, clip_vertex_t *out, uint16_t plane, Vector2 guard)
+    {
+        int out_count = 0;
+
+        for (int i = 0; i < count; i++)
+        {
+            const clip_vertex_t &a = in[i];
+            const clip_vertex_t &b = in[(i + 1) % count];
+
+            float da = clip_plane_distance(a.position, plane, guard);
+            float db = clip_plane_distance(b.position, plane, guard);
+
+            if (da >= 0)
+                out[out_count++] = a;
+
+            // the edge crosses the plane, add the intersection point. it is always computed from the inside corner
+            // towards the outside one, so the neighbouring triangle gets the exact same point on a shared edge.
+            if ((da >= 0) != (db >= 0))
+            {
+                const clip_vertex_t &in_v = da >= 0 ? a : b;
+                const clip_vertex_t &out_v = da >= 0 ? b : a;
+                float d_in = da >= 0 ? da : db;
+                float d_out = da >= 0 ? db : da;
+
+                float t = d_in / (d_in - d_out);
+                out[out_count++] = {
+                    lerp_v4(in_v.position, out_v.position, t),
+                    Vector2Lerp(in_v.uv, out_v.uv, t)};
+            }
+        }
+
+        return out_count;
+    }
+
+#pragma endregion
+
+#pragma region rasterization
+
+    // output of the vertex stage, one entry per mesh vertex (plus padding) in every array.
+    // the arrays live in the renderer's frame arena and are gone after the frame.
+    struct transformed_vertices_t
+    {
+        float *clip_x = nullptr;
+        float *clip_y = nullptr;
+        float *clip_z = nullptr;
+        float *clip_w = nullptr;   // camera space depth
+        float *screen_x = nullptr; // screen_x and screen_y are only meaningful when the outcode has none of the CLIP_NEEDS_CUT bits
+        float *screen_y = nullptr;
+        uint16_t *outcodes = nullptr;
+
+        // one flag per mesh cluster, only the vertices of clusters flagged 1 were transformed.
+        // null for meshes without clusters.
+        const uint8_t *clusters_visible = nullptr;
+
+        void allocate(frame_arena_t &arena, size_t count)
+        {
+            // 32 byte alignment keeps the vertex stage's vector loads and stores from splitting cache lines
+            clip_x = (float *)arena.allocate(count * sizeof(float), 32);
+            clip_y = (float *)arena.allocate(count * sizeof(float), 32);
+            clip_z = (float *)arena.allocate(count * sizeof(float), 32);
+            clip_w = (float *)arena.allocate(count * sizeof(float), 32);
+            screen_x = (float *)arena.allocate(count * sizeof(float), 32);
+            screen_y = (float *)arena.allocate(count * sizeof(float), 32);
+            outcodes = arena.allocate<uint16_t>(count);
+        }
+
+        Vector4 clip(int i) const
+        {
+            return {clip_x[i], clip_y[i], clip_z[i], clip_w[i]};
+        }
+
+        Vector2 screen(int i) const
+        {
+            return {screen_x[i], screen_y[i]};
+        }
+    };
+
+    // triangle corner after the vertex stage, everything the rasterizer needs to know about it
+    struct raster_vertex_t
+    {
+        Vector2 screen; // pixel position
+        float z;        // camera space depth
+        Vector2 uv;
+    };
+
+    // screen space plane of a linearly interpolated attribute: value(x, y) = c + dx * x + dy * y.
+    // the rasterizer always evaluates it as in_row(row(y), x), so a pixel gets the same value however its row is walked.
+    struct attribute_plane_t
+    {
+        float dx;
+        float dy;
+        float c;
+
+        float row(int y) const
+        {
+            return c + dy * y;
+        }
+
+        float in_row(float row_value, int x) const
+        {
+            return row_value + dx * x;
+        }
+    };
+
+    // output of the triangle setup stage, constant for every pixel of the triangle
+    struct triangle_setup_t
+    {
+        vec2i_t v0;
+        vec2i_t v1;
+        vec2i_t v2;
+        int bias0; // top-left fill rule bias of each edge
+        int bias1;
+        int bias2;
+        rect_t bounds;
+        float inv_area;
+
+        attribute_plane_t inv_z;
+        attribute_plane_t u_over_z;
+        attribute_plane_t v_over_z;
+
+        const texture_t *texture;
+    };
+
+#pragma endregion
+
+    class Renderer
+    {
+    private:
+        texture_t default_texture = {}; // used by instances that have no texture of their own
+
+        // all scratch memory of a frame (vertex stage output, set up triangles, tile bins) comes from here and is
+        // dropped in one go at the end of render_scene.
+        frame_arena_t frame_arena;
+
+        // tiled (sort-middle) rendering state. tile_workers is null while tiled rendering is off.
+        // every tile bin holds indices into frame_triangles, in submission order.
+        int tile_size = 64;
+        std::unique_ptr<thread_pool_t> tile_workers;
+        frame_vector_t<triangle_setup_t> frame_triangles;
+        frame_vector_t<uint32_t> *tile_bins = nullptr;
+        vector<uint8_t> tile_dirty; // 1 when the tile's slice of the buffers has to be cleared before it is drawn again
+        Color tiles_clear_color = {};
+
+        // software framebuffer. the rasterizer writes packed RGBA pixels here and present() uploads
+        // the whole buffer to framebuffer_texture once per frame. both buffers live across frames and
+        // are only reallocated when the window size changes.
+        depth_buffer_t inv_z_buffer;
+        vector<Color> color_buffer;
+        int buffer_width = 0;
+        int buffer_height = 0;
+        Texture2D framebuffer_texture = {};
+
+        // viewport and scissor of the current render_scene call. when no viewport was set they follow
+        // the window size. nothing outside scissor is ever cleared or drawn.
+        bool viewport_set = false;
+        viewport_t viewport = {};
+        rect_t scissor = {};
+        Matrix frame_view_projection = {};
+        Vector3 frame_camera_position = {};
+        float frame_pixels_per_unit = 0; // on screen, for something one unit in front of the camera
+
+        // occlusion culling, off while occlusion_scale is 0. the scene's occluders are drawn depth only into
+        // occlusion_buffer, which covers the viewport at 1/occlusion_scale of its resolution. BVH nodes and
+        // instances whose boxes are behind the occluders everywhere are skipped.
+        int occlusion_scale = 0;
+        depth_buffer_t occlusion_buffer;
+        viewport_t occlusion_viewport = {};
+
+    public:
+        Color clear_color = RAYWHITE;
+
+        // instances are drawn with the coarsest LOD of their mesh that is off by at most this many pixels.
+        // 0 always draws the full mesh.
+        float lod_pixel_error = 1.0f;
+
+        std::string get_full_path(const std::string &relative_path_str)
+        {
+            namespace fs = std::filesystem;
+
+            fs::path current_path = fs::current_path();
+            fs::path relative_path = relative_path_str;
+            fs::path full_path = current_path / relative_path;
+            
+            return full_path.string();
+        }
+
+        Renderer(std::string path_to_texture)
+        {
+            default_texture = load_texture(get_full_path(path_to_texture));
         }
         ~Renderer()
         {
-            UnloadImage(model_texture);
-            UnloadImageColors(model_tex_colors);
+            unload_texture(default_texture);
+            if (framebuffer_texture.id != 0)
+                UnloadTexture(framebuffer_texture);
         }
 
         // finds the cross product between ab and ap vectors
@@ -258,30 +1485,26 @@ namespace ssr
             return is_top || is_left;
         }
 
-        bool is_back_face(const triangle_t& t, const std::vector<Vector3>& cam_space_verts)
+        // the test runs on the (x, y, w) part of the clip space positions. the projection only scales camera space x and y
+        // by positive factors and copies camera space z into w, so the sign comes out the same as doing it in camera space,
+        // and it still works for corners behind the camera.
+        bool is_back_face(const triangle_t& t, const transformed_vertices_t& verts)
         {
-            Vector3 triangle_position = Vector3Scale(
-                Vector3Add(
-                    Vector3Add(
-                        cam_space_verts[t.v1.p],
-                        cam_space_verts[t.v2.p]),
-                    cam_space_verts[t.v3.p]),
-                1.0f / 3.0f);
-
-            // get point_to_cam vector
-            Vector3 v = Vector3Negate(triangle_position); // in the cam space cam is in origin, no need to substract cam's position to get the vector.
-
             // clock wise order
-            Vector3 a = cam_space_verts[t.v1.p];
-            Vector3 b = cam_space_verts[t.v2.p];
-            Vector3 c = cam_space_verts[t.v3.p];
+            Vector4 ca = verts.clip(t.v1);
+            Vector4 cb = verts.clip(t.v2);
+            Vector4 cc = verts.clip(t.v3);
+
+            Vector3 a = {ca.x, ca.y, ca.w};
+            Vector3 b = {cb.x, cb.y, cb.w};
+            Vector3 c = {cc.x, cc.y, cc.w};
 
             // get normal
-            Vector3 ab = Vector3Subtract(b, a);
-            Vector3 ac = Vector3Subtract(c, a);
-            Vector3 n = Vector3CrossProduct(ab, ac);
+            Vector3 n = Vector3CrossProduct(Vector3Subtract(b, a), Vector3Subtract(c, a));
 
-            float bf = Vector3DotProduct(v, n);
+            // in the cam space cam is in origin, so -a is the vector from the triangle to the camera.
+            // any point of the triangle works here, the normal is perpendicular to the triangle.
+            float bf = Vector3DotProduct(Vector3Negate(a), n);
 
             // if dot product is negetive between normal of the surface and vector to camera then don't draw it because it is a back-face triangle
             if (bf <= 0)
@@ -291,137 +1514,1066 @@ namespace ssr
             return false;
         }
 
-        void draw_triangle2(const triangle_t& t, const std::vector<Vector3> camera_space_vertices, const std::vector<Vector2>& screen_vertices, std::vector<float>& inv_z_buffer, const model_t& model)
+        // smallest / largest value an edge function takes over a block that starts at value w and spans dx_count x dy_count
+        // pixel steps. edge functions are linear, so these are found at the corners of the block.
+        int edge_min_in_block(int w, int step_x, int step_y, int dx_count, int dy_count)
+        {
+            return w + std::min(step_x, 0) * dx_count + std::min(step_y, 0) * dy_count;
+        }
+
+        int edge_max_in_block(int w, int step_x, int step_y, int dx_count, int dy_count)
         {
-            vec2i_t v0 = {(int)screen_vertices[t.v1.p].x, (int)screen_vertices[t.v1.p].y};
-            vec2i_t v1 = {(int)screen_vertices[t.v2.p].x, (int)screen_vertices[t.v2.p].y};
-            vec2i_t v2 = {(int)screen_vertices[t.v3.p].x, (int)screen_vertices[t.v3.p].y};
+            return w + std::max(step_x, 0) * dx_count + std::max(step_y, 0) * dy_count;
+        }
 
-            int x_min = std::min({v0.x, v1.x, v2.x});
-            int y_min = std::min({v0.y, v1.y, v2.y});
-            int x_max = std::max({v0.x, v1.x, v2.x});
-            int y_max = std::max({v0.y, v1.y, v2.y});
+        rect_t intersect(const rect_t& a, const rect_t& b)
+        {
+            return {std::max(a.x_min, b.x_min), std::max(a.y_min, b.y_min), std::min(a.x_max, b.x_max), std::min(a.y_max, b.y_max)};
+        }
 
-            // find the area of triangle
-            float area = edge_cross(v0, v1, v2);
+        bool is_empty(const rect_t& r)
+        {
+            return r.x_min > r.x_max || r.y_min > r.y_max;
+        }
 
-            int bias0 = edge_is_top_or_left(v0, v1) ? 0 : -1;
-            int bias1 = edge_is_top_or_left(v1, v2) ? 0 : -1;
-            int bias2 = edge_is_top_or_left(v2, v0) ? 0 : -1;
+        bool same_color(Color a, Color b)
+        {
+            return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+        }
 
-            for (int x = x_min; x <= x_max; x++)
-            {
-                for (int y = y_min; y <= y_max; y++)
-                {
-                    vec2i_t p = {x, y};
+        rect_t screen_rect()
+        {
+            return {0, 0, buffer_width - 1, buffer_height - 1};
+        }
 
-                    // areas
-                    int w0 = edge_cross(v0, v1, p) + bias0;
-                    int w1 = edge_cross(v1, v2, p) + bias1;
-                    int w2 = edge_cross(v2, v0, p) + bias2;
+        // plane through the values f0, f1, f2 at the corners of an already set up triangle. any per-vertex
+        // attribute can be interpolated this way, divide it by z first if it has to be perspective-correct.
+        attribute_plane_t setup_attribute(const triangle_setup_t& s, float f0, float f1, float f2)
+        {
+            float x1 = (float)(s.v1.x - s.v0.x);
+            float y1 = (float)(s.v1.y - s.v0.y);
+            float x2 = (float)(s.v2.x - s.v0.x);
+            float y2 = (float)(s.v2.y - s.v0.y);
 
-                    bool is_inside = w0 >= 0 && w1 >= 0 && w2 >= 0;
+            float d1 = f1 - f0;
+            float d2 = f2 - f0;
 
-                    if (is_inside)
-                    {
-                        // calculate barycentric weight of each vertex for the point
-                        float v0_f = (float)w1 / area;
-                        float v1_f = (float)w2 / area;
-                        float v2_f = (float)w0 / area;
-
-                        Color texelColor = MAGENTA;
-
-                        // calculate depth for z depth test (in camera space)
-                        float z0 = camera_space_vertices[t.v1.p].z;
-                        float z1 = camera_space_vertices[t.v2.p].z;
-                        float z2 = camera_space_vertices[t.v3.p].z;
-
-                        // interpolated 1/z value (in camera space)
-                        float depth = 1 / (z0 * v0_f + z1 * v1_f + z2 * v2_f);
-
-                        // perspective-correct texture mapping
-                        // by dividing z(z value comes from camera space btw) we are essentially applying perspective division
-                        // to the uv coordinates. this way we count for perspective when we are doing our texture mapping.
-                        float u0 = model.mesh.uvs[t.v1.uv].x / z0;
-                        float v0 = model.mesh.uvs[t.v1.uv].y / z0;
-                        float u1 = model.mesh.uvs[t.v2.uv].x / z1;
-                        float v1 = model.mesh.uvs[t.v2.uv].y / z1;
-                        float u2 = model.mesh.uvs[t.v3.uv].x / z2;
-                        float v2 = model.mesh.uvs[t.v3.uv].y / z2;
-
-                        // we are interpolate this perspective divided uv values by barycentric weights.
-                        // this makes sense because when we apply perspective division to the uv coordinates
-                        // we basically project them onto screen.
-                        // so we can interpolate them by barycentric weights which also comes from rectangle that is porjected onto screen.
-                        // we are interpolating in the same space.
-                        // after we are done with interpolation we are reverse the perspective effect by dividing depth which itself is 1/z
-                        float u = (u0 * v0_f + u1 * v1_f + u2 * v2_f) / depth;
-                        float v = (v0 * v0_f + v1 * v1_f + v2 * v2_f) / depth;
-
-                        u = Clamp(u, 0, 1);
-                        v = Clamp(v, 0, 1);
-
-                        int tex_x = (int)(u * (model_texture.width - 1));
-                        int tex_y = (int)(v * (model_texture.height - 1));
-
-                        int index = tex_y * model_texture.width + tex_x;
-                        texelColor = model_tex_colors[index];
-
-                        //check depth and draw pixel
-                        if (depth > inv_z_buffer[y * GetScreenWidth() + x])
-                        {
-                            inv_z_buffer[y * GetScreenWidth() + x] = depth;
-                            DrawPixel(x, y, texelColor);
-                        }
-                    }
-                }
-            }
+            attribute_plane_t p;
+            p.dx = (d1 * y2 - d2 * y1) * s.inv_area;
+            p.dy = (d2 * x1 - d1 * x2) * s.inv_area;
+            p.c = f0 - p.dx * s.v0.x - p.dy * s.v0.y;
+
+            return p;
         }
 
-        void render2(const model_t& model, const camera_t& cam, vector<float>& inv_z_buffer)
+        // triangle setup: everything that is constant over the triangle is computed here once, so the pixel loop only
+        // has to step edge values and attribute planes. returns false if the triangle can't cover any pixel.
+        bool setup_triangle(const raster_vertex_t& a, const raster_vertex_t& b, const raster_vertex_t& c, triangle_setup_t& s)
         {
-            vector<Vector2> protected_vertices = {};
-            vector<Vector3> camera_space_vertices = {};
-            
-            for (size_t i = 0; i < model.mesh.vertices.size(); i++)
-            {
-                Vector3 v_world = transform_to_world_space(model.mesh.vertices[i], model.transform);
+            s.v0 = {(int)a.screen.x, (int)a.screen.y};
+            s.v1 = {(int)b.screen.x, (int)b.screen.y};
+            s.v2 = {(int)c.screen.x, (int)c.screen.y};
+
+            // find the area of triangle. pixels are inside when all edge functions are >= 0, which a triangle
+            // with zero or negative area can't satisfy.
+            int area = edge_cross(s.v0, s.v1, s.v2);
+            if (area <= 0)
+                return false;
+
+            s.inv_area = 1.0f / (float)area;
+
+            s.bias0 = edge_is_top_or_left(s.v0, s.v1) ? 0 : -1;
+            s.bias1 = edge_is_top_or_left(s.v1, s.v2) ? 0 : -1;
+            s.bias2 = edge_is_top_or_left(s.v2, s.v0) ? 0 : -1;
+
+            s.bounds.x_min = std::min({s.v0.x, s.v1.x, s.v2.x});
+            s.bounds.y_min = std::min({s.v0.y, s.v1.y, s.v2.y});
+            s.bounds.x_max = std::max({s.v0.x, s.v1.x, s.v2.x});
+            s.bounds.y_max = std::max({s.v0.y, s.v1.y, s.v2.y});
+
+            // perspective-correct texture mapping
+            // by dividing z(z value comes from camera space btw) we are essentially applying perspective division
+            // to the uv coordinates. 1/z, u/z and v/z are linear in screen space, so they can be stepped across
+            // the triangle and the pixel loop gets u and v back by dividing with the interpolated 1/z.
+            float inv_z0 = 1.0f / a.z;
+            float inv_z1 = 1.0f / b.z;
+            float inv_z2 = 1.0f / c.z;
+
+            s.inv_z = setup_attribute(s, inv_z0, inv_z1, inv_z2);
+            s.u_over_z = setup_attribute(s, a.uv.x * inv_z0, b.uv.x * inv_z1, c.uv.x * inv_z2);
+            s.v_over_z = setup_attribute(s, a.uv.y * inv_z0, b.uv.y * inv_z1, c.uv.y * inv_z2);
+
+            return true;
+        }
 
-                Vector3 v_camera = transform_to_camera_space(v_world, cam);
-                camera_space_vertices.push_back(v_camera);
+        // corner of an indexed mesh triangle as seen by the rasterizer
+        raster_vertex_t raster_vertex(uint32_t i, const mesh_t& mesh, const transformed_vertices_t& verts)
+        {
+            return {verts.screen(i), verts.clip_w[i], mesh.uvs[i]};
+        }
+
+        // corner of a clipped polygon as seen by the rasterizer. the projection puts camera space z into w.
+        raster_vertex_t raster_vertex(const clip_vertex_t& v)
+        {
+            Vector3 v_perspective_applied = apply_perspective_division(v.position);
+            return {map_ndc_to_screen(v_perspective_applied, viewport), v.position.w, v.uv};
+        }
 
-                Vector4 v_proj_applied = apply_projection_matrix(v_camera, cam);
+        // clips a front-facing mesh triangle and calls emit(const triangle_setup_t&) for every triangle that comes out
+        // of setup. triangles completely inside the near/far planes and the guard band skip clipping, triangles
+        // completely outside one frustum plane are dropped, the rest are cut in clip space and fanned back into triangles.
+        template <typename F>
+        void setup_face(const triangle_t& face, const mesh_t& mesh, const texture_t* texture, const transformed_vertices_t& verts, Vector2 guard, F&& emit)
+        {
+            uint16_t o0 = verts.outcodes[face.v1];
+            uint16_t o1 = verts.outcodes[face.v2];
+            uint16_t o2 = verts.outcodes[face.v3];
 
-                Vector3 v_perspective_applied = apply_perspective_division(v_proj_applied);
+            if (o0 & o1 & o2 & CLIP_FRUSTUM)
+                return;
 
-                Vector2 v_screen = map_ndc_to_screen(v_perspective_applied);
+            triangle_setup_t setup;
+            setup.texture = texture;
 
-                protected_vertices.push_back(v_screen);
+            if (!((o0 | o1 | o2) & CLIP_NEEDS_CUT))
+            {
+                if (setup_triangle(raster_vertex(face.v1, mesh, verts),
+                                   raster_vertex(face.v2, mesh, verts),
+                                   raster_vertex(face.v3, mesh, verts),
+                                   setup))
+                    emit(setup);
+                return;
             }
 
-            for (size_t i = 0; i < model.mesh.faces.size(); i++)
+            clip_vertex_t polygon[max_clipped_vertices + 1] = {
+                {verts.clip(face.v1), mesh.uvs[face.v1]},
+                {verts.clip(face.v2), mesh.uvs[face.v2]},
+                {verts.clip(face.v3), mesh.uvs[face.v3]}};
+            clip_vertex_t scratch[max_clipped_vertices + 1];
+            int count = 3;
+
+            uint16_t planes = (o0 | o1 | o2) & CLIP_NEEDS_CUT;
+            for (uint16_t plane = 1; plane <= CLIP_GUARD_TOP && count >= 3; plane <<= 1)
             {
-                if (is_back_face(model.mesh.faces[i], camera_space_vertices))
+                if (!(planes & plane))
                     continue;
 
-                draw_triangle2(model.mesh.faces[i], camera_space_vertices, protected_vertices, inv_z_buffer, model);
+                count = clip_polygon(polygon, count, scratch, plane, guard);
+                std::copy(scratch, scratch + count, polygon);
             }
-        }
 
-        void render_scene(const vector<model_t> scene, const camera_t cam)
-        {
-            std::vector<float> inv_z_buffer;
-            int size = GetScreenWidth() * GetScreenHeight();
-            for (int i = 0; i < size; i++)
+            if (count < 3)
+                return;
+
+            raster_vertex_t first = raster_vertex(polygon[0]);
+            raster_vertex_t previous = raster_vertex(polygon[1]);
+
+            for (int i = 2; i < count; i++)
             {
-                inv_z_buffer.push_back(0);
+                raster_vertex_t current = raster_vertex(polygon[i]);
+
+                if (setup_triangle(first, previous, current, setup))
+                    emit(setup);
+
+                previous = current;
             }
+        }
 
-            for (size_t i = 0; i < scene.size(); i++)
+        // rasterizes the part of a set up triangle that falls inside clip into inv_z_buffer and color_buffer, both stride
+        // pixels wide. depth_only only does the depth test and write and leaves color_buffer alone (it can be null then).
+        template <bool depth_only = false>
+        void draw_triangle2(const triangle_setup_t& s, const rect_t& clip, float* inv_z_buffer, Color* color_buffer, int stride)
+        {
+            rect_t bounds = intersect(s.bounds, clip);
+
+            if (is_empty(bounds))
+                return;
+
+            int x_min = bounds.x_min;
+            int y_min = bounds.y_min;
+            int x_max = bounds.x_max;
+            int y_max = bounds.y_max;
+
+            const int screen_w = stride;
+
+            // edge_cross is linear in p, so moving one pixel to the right changes it by (a.y - b.y)
+            // and moving one row down changes it by (b.x - a.x). we evaluate the three edges once
+            // at the top-left corner of the bounding box and only add these deltas in the loops.
+            int w0_dx = s.v0.y - s.v1.y;
+            int w1_dx = s.v1.y - s.v2.y;
+            int w2_dx = s.v2.y - s.v0.y;
+            int w0_dy = s.v1.x - s.v0.x;
+            int w1_dy = s.v2.x - s.v1.x;
+            int w2_dy = s.v0.x - s.v2.x;
+
+            vec2i_t p0 = {x_min, y_min};
+            int w0_origin = edge_cross(s.v0, s.v1, p0) + s.bias0;
+            int w1_origin = edge_cross(s.v1, s.v2, p0) + s.bias1;
+            int w2_origin = edge_cross(s.v2, s.v0, p0) + s.bias2;
+
+            const texture_t& texture = *s.texture;
+            const float tex_w = (float)(texture.width - 1);
+            const float tex_h = (float)(texture.height - 1);
+
+#if SSR_SIMD_LANES > 1
+            // the vector kernel below does exactly the same math as the scalar loop, just on
+            // SSR_SIMD_LANES neighbouring pixels of a row at once. everything that is constant for the
+            // triangle is broadcast to all lanes up front.
+            constexpr int lanes = SSR_SIMD_LANES;
+
+            const simd::vi w0_step = simd::set1(w0_dx * lanes);
+            const simd::vi w1_step = simd::set1(w1_dx * lanes);
+            const simd::vi w2_step = simd::set1(w2_dx * lanes);
+
+            const simd::vf x_step = simd::set1((float)lanes);
+            const simd::vf inv_z_dx = simd::set1(s.inv_z.dx);
+            const simd::vf u_over_z_dx = simd::set1(s.u_over_z.dx);
+            const simd::vf v_over_z_dx = simd::set1(s.v_over_z.dx);
+
+            const simd::vf one_l = simd::set1(1.0f);
+            const simd::vf zero_l = simd::set1(0.0f);
+            const simd::vf tex_w_l = simd::set1(tex_w);
+            const simd::vf tex_h_l = simd::set1(tex_h);
+#endif
+
+            // shades the pixels x..x_end of row y. w0, w1, w2 are the edge values at (x, y).
+            // when covered is true the caller already knows every pixel of the span is inside the triangle.
+            // tiles and blocks cut rows into spans at different places, so the attributes aren't stepped along the
+            // span but evaluated from the row's value at every pixel. that way tiled and untiled drawing produce the
+            // same bits, and depth ties resolve the same whatever the tile layout.
+            auto shade_span = [&](int y, int x, int x_end, int w0, int w1, int w2, bool covered)
             {
-                // render_model_instance(scene[i], cam, inv_z_buffer);
-                render2(scene[i], cam, inv_z_buffer);
-            }
+                float inv_z_row = s.inv_z.row(y);
+                float u_over_z_row = s.u_over_z.row(y);
+                float v_over_z_row = s.v_over_z.row(y);
+
+#if SSR_SIMD_LANES > 1
+                int x_start = x;
+
+                simd::vi w0_l = simd::ramp(w0, w0_dx);
+                simd::vi w1_l = simd::ramp(w1, w1_dx);
+                simd::vi w2_l = simd::ramp(w2, w2_dx);
+
+                // the same row + dx * x as attribute_plane_t::in_row, x is exact in a float
+                simd::vf x_l = simd::to_float(simd::ramp(x, 1));
+                const simd::vf inv_z_row_l = simd::set1(inv_z_row);
+                const simd::vf u_over_z_row_l = simd::set1(u_over_z_row);
+                const simd::vf v_over_z_row_l = simd::set1(v_over_z_row);
+
+                // only whole vectors go through here, the last few pixels of the span are left to the scalar loop
+                for (; x + lanes - 1 <= x_end; x += lanes)
+                {
+                    simd::vf inv_z_l = simd::add(inv_z_row_l, simd::mul(inv_z_dx, x_l));
+
+                    simd::vf inside = covered ? simd::true_mask() : simd::all_non_negative(w0_l, w1_l, w2_l);
+
+                    float *z_row = &inv_z_buffer[y * screen_w + x];
+                    simd::vf old_depth = simd::load(z_row);
+                    simd::vf write = simd::mask_and(inside, simd::greater(inv_z_l, old_depth));
+                    int write_bits = simd::bits(write);
+
+                    if (write_bits)
+                    {
+                        simd::store(z_row, simd::select(write, inv_z_l, old_depth));
+                    }
+
+                    if (!depth_only && write_bits)
+                    {
+                        simd::vf u_over_z_l = simd::add(u_over_z_row_l, simd::mul(u_over_z_dx, x_l));
+                        simd::vf v_over_z_l = simd::add(v_over_z_row_l, simd::mul(v_over_z_dx, x_l));
+
+                        simd::vf u = simd::div(u_over_z_l, inv_z_l);
+                        simd::vf v = simd::div(v_over_z_l, inv_z_l);
+
+                        u = simd::min(simd::max(u, zero_l), one_l);
+                        v = simd::min(simd::max(v, zero_l), one_l);
+
+                        int tex_x[lanes];
+                        int tex_y[lanes];
+                        simd::store(tex_x, simd::to_int(simd::mul(u, tex_w_l)));
+                        simd::store(tex_y, simd::to_int(simd::mul(v, tex_h_l)));
+
+                        // texel fetch and the pixel write stay per lane, but only for the lanes that passed
+                        for (int lane = 0; lane < lanes; lane++)
+                        {
+                            if (write_bits & (1 << lane))
+                            {
+                                int index = tex_y[lane] * texture.width + tex_x[lane];
+                                color_buffer[y * screen_w + x + lane] = texture.texels[index];
+                            }
+                        }
+                    }
+
+                    w0_l = simd::add(w0_l, w0_step);
+                    w1_l = simd::add(w1_l, w1_step);
+                    w2_l = simd::add(w2_l, w2_step);
+                    x_l = simd::add(x_l, x_step);
+                }
+
+                if (x > x_end)
+                    return;
+
+                w0 += (x - x_start) * w0_dx;
+                w1 += (x - x_start) * w1_dx;
+                w2 += (x - x_start) * w2_dx;
+#endif
+
+                for (; x <= x_end; x++)
+                {
+                    bool is_inside = covered || (w0 >= 0 && w1 >= 0 && w2 >= 0);
+                    float inv_z = s.inv_z.in_row(inv_z_row, x);
+
+                    //check depth and draw pixel
+                    if (is_inside && inv_z > inv_z_buffer[y * screen_w + x])
+                    {
+                        inv_z_buffer[y * screen_w + x] = inv_z;
+
+                        if (!depth_only)
+                        {
+                            float u_over_z = s.u_over_z.in_row(u_over_z_row, x);
+                            float v_over_z = s.v_over_z.in_row(v_over_z_row, x);
+
+                            // after we are done with interpolation we are reverse the perspective effect by dividing by 1/z
+                            float u = Clamp(u_over_z / inv_z, 0, 1);
+                            float v = Clamp(v_over_z / inv_z, 0, 1);
+
+                            int tex_x = (int)(u * tex_w);
+                            int tex_y = (int)(v * tex_h);
+
+                            int index = tex_y * texture.width + tex_x;
+                            color_buffer[y * screen_w + x] = texture.texels[index];
+                        }
+                    }
+
+                    w0 += w0_dx;
+                    w1 += w1_dx;
+                    w2 += w2_dx;
+                }
+            };
+
+            // coarse pass over block_size x block_size blocks of the bounding box. the edge functions are linear, so their
+            // smallest and largest value inside a block are at its corners. a block that is entirely on the wrong side of
+            // one edge is skipped, a block that is inside all three edges is shaded without the per-pixel coverage test,
+            // and only blocks that straddle an edge take the per-pixel path.
+            constexpr int block_size = 8;
+
+            for (int by = y_min; by <= y_max; by += block_size)
+            {
+                int by_max = std::min(by + block_size - 1, y_max);
+
+                for (int bx = x_min; bx <= x_max; bx += block_size)
+                {
+                    int bx_max = std::min(bx + block_size - 1, x_max);
+                    int bw = bx_max - bx;
+                    int bh = by_max - by;
+
+                    int w0 = w0_origin + (bx - x_min) * w0_dx + (by - y_min) * w0_dy;
+                    int w1 = w1_origin + (bx - x_min) * w1_dx + (by - y_min) * w1_dy;
+                    int w2 = w2_origin + (bx - x_min) * w2_dx + (by - y_min) * w2_dy;
+
+                    if (edge_max_in_block(w0, w0_dx, w0_dy, bw, bh) < 0 ||
+                        edge_max_in_block(w1, w1_dx, w1_dy, bw, bh) < 0 ||
+                        edge_max_in_block(w2, w2_dx, w2_dy, bw, bh) < 0)
+                        continue;
+
+                    bool covered = edge_min_in_block(w0, w0_dx, w0_dy, bw, bh) >= 0 &&
+                                   edge_min_in_block(w1, w1_dx, w1_dy, bw, bh) >= 0 &&
+                                   edge_min_in_block(w2, w2_dx, w2_dy, bw, bh) >= 0;
+
+                    // walk the block row by row so inv_z_buffer is touched in memory order
+                    for (int y = by; y <= by_max; y++, w0 += w0_dy, w1 += w1_dy, w2 += w2_dy)
+                    {
+                        shade_span(y, bx, bx_max, w0, w1, w2, covered);
+                    }
+                }
+            }
+        }
+
+        // vertex stage for the vertices [first, last) of the mesh, transformed by the model-view-projection matrix m.
+        // first and last have to be multiples of vertex_stream_padding. meshes whose position streams were built go
+        // through the SIMD loop, anything else takes the scalar loop over mesh.vertices. the SIMD loop is the same math
+        // in the same order as mul_v3_mat, compute_outcode, apply_perspective_division and map_ndc_to_screen, just on
+        // SSR_SIMD_LANES vertices at a time.
+        void transform_vertex_range(const mesh_t& mesh, size_t first, size_t last, const Matrix& m, Vector2 guard, transformed_vertices_t& verts)
+        {
+#if SSR_SIMD_LANES > 1
+            if (mesh.position_x.size() == padded_vertex_count(mesh.vertices.size()))
+            {
+                using namespace simd;
+
+                vf m0 = set1(m.m0), m4 = set1(m.m4), m8 = set1(m.m8), m12 = set1(m.m12);
+                vf m1 = set1(m.m1), m5 = set1(m.m5), m9 = set1(m.m9), m13 = set1(m.m13);
+                vf m2 = set1(m.m2), m6 = set1(m.m6), m10 = set1(m.m10), m14 = set1(m.m14);
+                vf m3 = set1(m.m3), m7 = set1(m.m7), m11 = set1(m.m11), m15 = set1(m.m15);
+
+                vf zero = set1(0.0f);
+                vf one = set1(1.0f);
+                vf half = set1(0.5f);
+                vf guard_x = set1(guard.x);
+                vf guard_y = set1(guard.y);
+                vf neg_guard_x = set1(-guard.x);
+                vf neg_guard_y = set1(-guard.y);
+                vf vp_x = set1((float)viewport.x);
+                vf vp_y = set1((float)viewport.y);
+                vf vp_w = set1((float)viewport.width);
+                vf vp_h = set1((float)viewport.height);
+
+                int codes[SSR_SIMD_LANES];
+
+                for (size_t i = first; i < last; i += SSR_SIMD_LANES)
+                {
+                    vf x = load(&mesh.position_x[i]);
+                    vf y = load(&mesh.position_y[i]);
+                    vf z = load(&mesh.position_z[i]);
+
+                    vf cx = add(add(add(mul(x, m0), mul(y, m4)), mul(z, m8)), m12);
+                    vf cy = add(add(add(mul(x, m1), mul(y, m5)), mul(z, m9)), m13);
+                    vf cz = add(add(add(mul(x, m2), mul(y, m6)), mul(z, m10)), m14);
+                    vf cw = add(add(add(mul(x, m3), mul(y, m7)), mul(z, m11)), m15);
+
+                    store(&verts.clip_x[i], cx);
+                    store(&verts.clip_y[i], cy);
+                    store(&verts.clip_z[i], cz);
+                    store(&verts.clip_w[i], cw);
+
+                    vf neg_w = sub(zero, cw);
+                    vi code = mask_bits(less(cz, zero), CLIP_NEAR);
+                    code = bit_or(code, mask_bits(greater(cz, cw), CLIP_FAR));
+                    code = bit_or(code, mask_bits(less(cx, neg_w), CLIP_LEFT));
+                    code = bit_or(code, mask_bits(greater(cx, cw), CLIP_RIGHT));
+                    code = bit_or(code, mask_bits(less(cy, neg_w), CLIP_BOTTOM));
+                    code = bit_or(code, mask_bits(greater(cy, cw), CLIP_TOP));
+                    code = bit_or(code, mask_bits(less(cx, mul(neg_guard_x, cw)), CLIP_GUARD_LEFT));
+                    code = bit_or(code, mask_bits(greater(cx, mul(guard_x, cw)), CLIP_GUARD_RIGHT));
+                    code = bit_or(code, mask_bits(less(cy, mul(neg_guard_y, cw)), CLIP_GUARD_BOTTOM));
+                    code = bit_or(code, mask_bits(greater(cy, mul(guard_y, cw)), CLIP_GUARD_TOP));
+
+                    store(codes, code);
+                    for (int lane = 0; lane < SSR_SIMD_LANES; lane++)
+                    {
+                        verts.outcodes[i + lane] = (uint16_t)codes[lane];
+                    }
+
+                    // padding lanes are either a cluster's last vertex repeated or the zero positions past the end of
+                    // the streams (so w = m15 there). no face indexes them, so what they divide to is never read
+                    vf ndc_x = div(cx, cw);
+                    vf ndc_y = div(cy, cw);
+
+                    store(&verts.screen_x[i], add(vp_x, mul(mul(add(ndc_x, one), half), vp_w)));
+                    store(&verts.screen_y[i], add(vp_y, mul(mul(sub(one, ndc_y), half), vp_h)));
+                }
+                return;
+            }
+#endif
+
+            last = std::min(last, mesh.vertices.size());
+
+            for (size_t i = first; i < last; i++)
+            {
+                Vector4 v_clip = mul_v3_mat(mesh.vertices[i], m);
+                verts.clip_x[i] = v_clip.x;
+                verts.clip_y[i] = v_clip.y;
+                verts.clip_z[i] = v_clip.z;
+                verts.clip_w[i] = v_clip.w;
+                verts.outcodes[i] = compute_outcode(v_clip, guard);
+
+                Vector3 v_perspective_applied = apply_perspective_division(v_clip);
+                Vector2 screen = map_ndc_to_screen(v_perspective_applied, viewport);
+
+                verts.screen_x[i] = screen.x;
+                verts.screen_y[i] = screen.y;
+            }
+        }
+
+        // vertex stage for instance_count instances of one mesh. outs[k] gets the mesh's vertices transformed by mvps[k],
+        // but only for the clusters flagged in clusters_visible[k] (all of them for meshes without clusters). the mesh is
+        // walked one cluster (or a few hundred vertices) at a time and every instance of the batch goes over that piece
+        // while it is in L1.
+        void transform_vertices(const mesh_t& mesh, const Matrix* mvps, const uint8_t* const* clusters_visible, int instance_count, transformed_vertices_t* outs)
+        {
+            size_t padded = padded_vertex_count(mesh.vertices.size());
+
+            for (int k = 0; k < instance_count; k++)
+            {
+                outs[k].allocate(frame_arena, padded);
+                outs[k].clusters_visible = clusters_visible[k];
+            }
+
+            Vector2 guard = get_guard_band(viewport);
+
+            if (mesh.clusters.empty())
+            {
+                constexpr size_t chunk_size = 256;
+
+                for (size_t chunk = 0; chunk < padded; chunk += chunk_size)
+                {
+                    size_t chunk_end = std::min(chunk + chunk_size, padded);
+
+                    for (int k = 0; k < instance_count; k++)
+                    {
+                        transform_vertex_range(mesh, chunk, chunk_end, mvps[k], guard, outs[k]);
+                    }
+                }
+                return;
+            }
+
+            for (size_t c = 0; c < mesh.clusters.size(); c++)
+            {
+                const cluster_t& cluster = mesh.clusters[c];
+
+                for (int k = 0; k < instance_count; k++)
+                {
+                    if (clusters_visible[k][c])
+                        transform_vertex_range(mesh, cluster.first_vertex, cluster.first_vertex + cluster.vertex_count, mvps[k], guard, outs[k]);
+                }
+            }
+        }
+
+        // the coarsest LOD of mesh whose error stays below lod_pixel_error pixels on screen, for an instance with
+        // the given model matrix and scale. the error is measured at the point of the bounding sphere nearest to the camera.
+        const mesh_t& select_lod(const mesh_t& mesh, const Matrix& model, Vector3 scale)
+        {
+            if (mesh.lods.empty() || lod_pixel_error <= 0)
+                return mesh;
+
+            float max_scale = std::max({fabsf(scale.x), fabsf(scale.y), fabsf(scale.z)});
+            Vector3 center = Vector3Transform(mesh.bounds.center, model);
+            float depth = mul_v3_mat(center, frame_view_projection).w - mesh.bounds.radius * max_scale;
+            if (depth <= 0)
+                return mesh;
+
+            float pixels_per_unit = frame_pixels_per_unit * max_scale / depth;
+
+            const mesh_t* lod = &mesh;
+            for (const mesh_t& coarser : mesh.lods)
+            {
+                if (coarser.lod_error * pixels_per_unit > lod_pixel_error)
+                    break;
+                lod = &coarser;
+            }
+            return *lod;
+        }
+
+        // frustum, LOD selection, cluster and normal cone culling of one instance. returns false when nothing of it
+        // can be seen, otherwise fills in the mesh to draw (a LOD when use_lods is set), its model-view-projection
+        // matrix and cluster flags (null for meshes without clusters).
+        bool is_instance_visible(const scene_t& scene, size_t i, bool use_lods, const mesh_t*& lod, Matrix& mvp, const uint8_t*& clusters_visible)
+        {
+            const mesh_t& full = scene.mesh(scene.get_instances()[i].mesh);
+            const transform_t& transform = scene.get_transforms()[i];
+
+            Matrix model = get_model_matrix(transform);
+            mvp = MatrixMultiply(model, frame_view_projection);
+            frustum_t frustum = get_frustum(mvp);
+
+            if (is_mesh_outside(full.bounds, frustum, mvp))
+                return false;
+
+            lod = use_lods ? &select_lod(full, model, transform.scale) : &full;
+            const mesh_t& mesh = *lod;
+
+            clusters_visible = nullptr;
+            if (mesh.clusters.empty())
+                return true;
+
+            // the camera in the mesh's object space. a mirroring transform flips the winding, the cone test
+            // is skipped for those and their faces are left to is_back_face.
+            Vector3 eye = Vector3Transform(frame_camera_position, MatrixInvert(model));
+            bool cone_test = MatrixDeterminant(model) > 0;
+
+            uint8_t* cluster_flags = frame_arena.allocate<uint8_t>(mesh.clusters.size());
+
+            bool any_visible = false;
+            for (size_t c = 0; c < mesh.clusters.size(); c++)
+            {
+                cluster_flags[c] = !is_cluster_culled(mesh.clusters[c], frustum, eye, cone_test);
+                any_visible |= cluster_flags[c] != 0;
+            }
+
+            clusters_visible = cluster_flags;
+            return any_visible;
+        }
+
+        // draws the scene's occluders depth only into occlusion_buffer. returns false when there is nothing to test against.
+        bool build_occlusion_buffer(const scene_t& scene)
+        {
+            const vector<uint32_t>& occluders = scene.get_occluders();
+            if (occlusion_scale == 0 || occluders.empty())
+                return false;
+
+            occlusion_viewport = {0, 0, std::max(1, viewport.width / occlusion_scale), std::max(1, viewport.height / occlusion_scale)};
+            int w = occlusion_viewport.width;
+            int h = occlusion_viewport.height;
+
+            occlusion_buffer.resize(w * h);
+            simd::fill(occlusion_buffer.data(), occlusion_buffer.size(), 0.0f);
+
+            // the vertex stage and triangle setup map to whatever viewport is set, point them at the small buffer
+            viewport_t main_viewport = viewport;
+            viewport = occlusion_viewport;
+
+            rect_t occlusion_rect = {0, 0, w - 1, h - 1};
+
+            for (uint32_t i : occluders)
+            {
+                // the full mesh, a LOD's outline isn't guaranteed to stay inside the original's
+                const mesh_t* lod;
+                Matrix mvp;
+                const uint8_t* clusters_visible;
+                if (!is_instance_visible(scene, i, false, lod, mvp, clusters_visible))
+                    continue;
+
+                const instance_t& instance = scene.get_instances()[i];
+                const mesh_t& mesh = *lod;
+
+                transformed_vertices_t verts;
+                transform_vertices(mesh, &mvp, &clusters_visible, 1, &verts);
+
+                setup_instance(scene, instance, mesh, verts, [&](const triangle_setup_t& setup)
+                {
+                    draw_triangle2<true>(setup, occlusion_rect, occlusion_buffer.data(), nullptr, w);
+                });
+            }
+
+            viewport = main_viewport;
+
+            // a pixel only tells what covers its center. keeping the farthest depth of every 3x3 neighbourhood makes
+            // each pixel stand for its whole area, so a box is never reported hidden because of a partly covered pixel.
+            // neighbours outside the buffer count as empty: nothing is known about the part of a border pixel that
+            // reaches past the edge, and boxes clamped to the border have to stay visible.
+            float* eroded = frame_arena.allocate<float>(w * h);
+            for (int y = 0; y < h; y++)
+            {
+                for (int x = 0; x < w; x++)
+                {
+                    if (x == 0 || y == 0 || x == w - 1 || y == h - 1)
+                    {
+                        eroded[y * w + x] = 0;
+                        continue;
+                    }
+
+                    float farthest = occlusion_buffer[y * w + x];
+                    for (int ny = std::max(y - 1, 0); ny <= std::min(y + 1, h - 1); ny++)
+                    {
+                        for (int nx = std::max(x - 1, 0); nx <= std::min(x + 1, w - 1); nx++)
+                        {
+                            farthest = std::min(farthest, occlusion_buffer[ny * w + nx]);
+                        }
+                    }
+                    eroded[y * w + x] = farthest;
+                }
+            }
+            std::copy(eroded, eroded + w * h, occlusion_buffer.begin());
+
+            return true;
+        }
+
+        // true when the world space box is behind the occluders at every pixel it covers
+        bool is_box_occluded(const aabb_t& box)
+        {
+            float x_min = FLT_MAX, y_min = FLT_MAX, x_max = -FLT_MAX, y_max = -FLT_MAX;
+            float nearest_inv_z = 0;
+
+            for (int i = 0; i < 8; i++)
+            {
+                Vector3 corner = {i & 1 ? box.max.x : box.min.x, i & 2 ? box.max.y : box.min.y, i & 4 ? box.max.z : box.min.z};
+                Vector4 clip = mul_v3_mat(corner, frame_view_projection);
+
+                // the box reaches through the near plane, its screen bounds are unknown
+                if (clip.z < 0)
+                    return false;
+
+                Vector2 p = map_ndc_to_screen(apply_perspective_division(clip), occlusion_viewport);
+                x_min = std::min(x_min, p.x);
+                y_min = std::min(y_min, p.y);
+                x_max = std::max(x_max, p.x);
+                y_max = std::max(y_max, p.y);
+                nearest_inv_z = std::max(nearest_inv_z, 1.0f / clip.w);
+            }
+
+            int w = occlusion_viewport.width;
+            int h = occlusion_viewport.height;
+
+            rect_t r = intersect({(int)floorf(x_min), (int)floorf(y_min), (int)ceilf(x_max), (int)ceilf(y_max)}, {0, 0, w - 1, h - 1});
+            if (is_empty(r))
+                return false;
+
+            for (int y = r.y_min; y <= r.y_max; y++)
+            {
+                for (int x = r.x_min; x <= r.x_max; x++)
+                {
+                    if (occlusion_buffer[y * w + x] <= nearest_inv_z)
+                        return false;
+                }
+            }
+
+            return true;
+        }
+
+        // runs the vertex stage for every instance of the scene that is not culled and calls fn(instance, mesh, verts)
+        // for each of them in scene order, with mesh being the LOD picked for the instance. the scene's instance BVH is walked against the world space frustum (and the
+        // occlusion buffer when occlusion culling is on) first, so only instances in (or near) the view are looked at
+        // one by one. instances whose mesh bounds are outside the view frustum or hidden behind occluders are dropped
+        // before any vertex work, and so are clusters outside the frustum or facing away from the camera. neighbouring
+        // visible instances drawn with the same mesh (or LOD) are transformed together as one batch, as long as the batch's output
+        // stays below max_batch_vertices.
+        template <typename F>
+        void for_each_transformed_instance(const scene_t& scene, F&& fn)
+        {
+            constexpr size_t max_batch_vertices = 1 << 16;
+
+            const vector<instance_t>& instances = scene.get_instances();
+            const bvh_t& bvh = scene.get_instance_bvh();
+
+            bool occlusion = build_occlusion_buffer(scene);
+
+            // flagging the BVH hits and walking the flags keeps the instances in scene order
+            uint8_t* in_view = frame_arena.allocate<uint8_t>(instances.size());
+            std::fill_n(in_view, instances.size(), 0);
+
+            frustum_t world_frustum = get_frustum(frame_view_projection);
+            bvh.traverse(
+                [&](const aabb_t& box)
+                {
+                    bvh_test_t result = classify_box(world_frustum, box);
+                    if (!occlusion || result == BVH_OUTSIDE)
+                        return result;
+
+                    // a node that is visible as a whole can still have hidden children
+                    return is_box_occluded(box) ? BVH_OUTSIDE : BVH_INTERSECTS;
+                },
+                [&](uint32_t i) { in_view[i] = 1; });
+
+            uint32_t* visible = frame_arena.allocate<uint32_t>(instances.size());
+            const mesh_t** lods = frame_arena.allocate<const mesh_t*>(instances.size());
+            Matrix* mvps = frame_arena.allocate<Matrix>(instances.size());
+            const uint8_t** clusters_visible = frame_arena.allocate<const uint8_t*>(instances.size());
+            size_t visible_count = 0;
+
+            for (size_t i = 0; i < instances.size(); i++)
+            {
+                if (!in_view[i])
+                    continue;
+
+                if (occlusion && is_box_occluded(scene.get_instance_box((instance_handle_t)i)))
+                    continue;
+
+                if (!is_instance_visible(scene, i, true, lods[visible_count], mvps[visible_count], clusters_visible[visible_count]))
+                    continue;
+
+                visible[visible_count] = (uint32_t)i;
+                visible_count++;
+            }
+
+            size_t first = 0;
+            while (first < visible_count)
+            {
+                const mesh_t& mesh = *lods[first];
+                size_t padded = padded_vertex_count(mesh.vertices.size());
+
+                size_t last = first + 1;
+                while (last < visible_count && lods[last] == &mesh &&
+                       (last - first + 1) * padded <= max_batch_vertices)
+                {
+                    last++;
+                }
+
+                int batch_size = (int)(last - first);
+                transformed_vertices_t* outs = frame_arena.allocate<transformed_vertices_t>(batch_size);
+                transform_vertices(mesh, &mvps[first], &clusters_visible[first], batch_size, outs);
+
+                for (int k = 0; k < batch_size; k++)
+                {
+                    fn(instances[visible[first + k]], mesh, outs[k]);
+                }
+
+                first = last;
+            }
+        }
+
+        // sends the front-facing triangles of one instance whose vertex stage already ran through setup_face. faces of
+        // culled clusters are skipped, their vertices were never transformed.
+        template <typename F>
+        void setup_instance(const scene_t& scene, const instance_t& instance, const mesh_t& mesh, const transformed_vertices_t& verts, F&& emit)
+        {
+            const texture_t* texture = scene.texture(instance.texture);
+            if (!texture)
+                texture = &default_texture;
+
+            Vector2 guard = get_guard_band(viewport);
+
+            auto setup_faces = [&](size_t first, size_t last)
+            {
+                for (size_t i = first; i < last; i++)
+                {
+                    triangle_t face = mesh.face(i);
+
+                    if (is_back_face(face, verts))
+                        continue;
+
+                    setup_face(face, mesh, texture, verts, guard, emit);
+                }
+            };
+
+            if (!verts.clusters_visible)
+            {
+                setup_faces(0, mesh.face_count());
+                return;
+            }
+
+            for (size_t c = 0; c < mesh.clusters.size(); c++)
+            {
+                if (verts.clusters_visible[c])
+                    setup_faces(mesh.clusters[c].first_face, mesh.clusters[c].first_face + mesh.clusters[c].face_count);
+            }
+        }
+
+        void render2(const scene_t& scene)
+        {
+            for_each_transformed_instance(scene, [&](const instance_t& instance, const mesh_t& mesh, const transformed_vertices_t& verts)
+            {
+                setup_instance(scene, instance, mesh, verts, [&](const triangle_setup_t& setup)
+                {
+                    draw_triangle2(setup, scissor, inv_z_buffer.data(), color_buffer.data(), buffer_width);
+                });
+            });
+        }
+
+        // sort-middle rendering: run the vertex stage for the whole scene, sort the front-facing triangles into
+        // tile_size x tile_size screen tiles and rasterize the tiles in parallel. a tile only ever writes the
+        // pixels inside it, so workers share inv_z_buffer and color_buffer without locking. triangles keep
+        // their submission order inside each tile, so the result matches render2.
+        void render_tiled(const scene_t& scene)
+        {
+            int screen_w = buffer_width;
+            int screen_h = buffer_height;
+            int tiles_x = (screen_w + tile_size - 1) / tile_size;
+            int tiles_y = (screen_h + tile_size - 1) / tile_size;
+
+            tile_bins = frame_arena.allocate<frame_vector_t<uint32_t>>(tiles_x * tiles_y);
+            for (int i = 0; i < tiles_x * tiles_y; i++)
+            {
+                new (&tile_bins[i]) frame_vector_t<uint32_t>(frame_arena);
+            }
+
+            if ((int)tile_dirty.size() != tiles_x * tiles_y || !same_color(tiles_clear_color, clear_color))
+            {
+                tile_dirty.assign(tiles_x * tiles_y, 1);
+                tiles_clear_color = clear_color;
+            }
+
+            frame_triangles = frame_vector_t<triangle_setup_t>(frame_arena);
+
+            auto bin_triangle = [&](const triangle_setup_t& setup)
+            {
+                rect_t bounds = intersect(setup.bounds, scissor);
+                if (is_empty(bounds))
+                    return;
+
+                uint32_t triangle_index = (uint32_t)frame_triangles.size();
+                frame_triangles.push_back(setup);
+
+                for (int ty = bounds.y_min / tile_size; ty <= bounds.y_max / tile_size; ty++)
+                {
+                    for (int tx = bounds.x_min / tile_size; tx <= bounds.x_max / tile_size; tx++)
+                    {
+                        tile_bins[ty * tiles_x + tx].push_back(triangle_index);
+                    }
+                }
+            };
+
+            for_each_transformed_instance(scene, [&](const instance_t& instance, const mesh_t& mesh, const transformed_vertices_t& verts)
+            {
+                setup_instance(scene, instance, mesh, verts, bin_triangle);
+            });
+
+            tile_workers->parallel_for(tiles_x * tiles_y, [&](int tile_index)
+            {
+                int tx = tile_index % tiles_x;
+                int ty = tile_index / tiles_x;
+
+                rect_t tile = {
+                    tx * tile_size,
+                    ty * tile_size,
+                    std::min((tx + 1) * tile_size, screen_w) - 1,
+                    std::min((ty + 1) * tile_size, screen_h) - 1};
+
+                rect_t region = intersect(tile, scissor);
+                if (is_empty(region))
+                    return;
+
+                // every tile clears its own slice. a tile that had nothing drawn into it since its last clear is skipped.
+                // that shortcut only holds while the scissor covers the whole tile, a partly covered tile always clears
+                // its part and stays dirty because other viewports may draw into the rest of it.
+                bool whole_tile = region.x_min == tile.x_min && region.y_min == tile.y_min && region.x_max == tile.x_max && region.y_max == tile.y_max;
+
+                if (!whole_tile)
+                {
+                    clear_buffers(region);
+                    tile_dirty[tile_index] = 1;
+                }
+                else
+                {
+                    if (tile_dirty[tile_index])
+                    {
+                        clear_buffers(tile);
+                    }
+                    tile_dirty[tile_index] = !tile_bins[tile_index].empty();
+                }
+
+                for (uint32_t triangle_index : tile_bins[tile_index])
+                {
+                    draw_triangle2(frame_triangles[triangle_index], region, inv_z_buffer.data(), color_buffer.data(), buffer_width);
+                }
+            });
+        }
+
+        // switches render_scene to tiled rendering. thread_count <= 0 uses every hardware core.
+        void enable_tiled_rendering(int thread_count = 0, int tile_size = 64)
+        {
+            this->tile_size = std::max(tile_size, 8);
+            tile_workers = std::make_unique<thread_pool_t>(thread_count);
+            tile_dirty.clear();
+        }
+
+        // occluders of the scene (see scene_t::set_occluder) are drawn into a depth buffer scale times smaller than the
+        // viewport in each direction, and everything found to be behind them is skipped
+        void enable_occlusion_culling(int scale = 4)
+        {
+            occlusion_scale = std::max(1, scale);
+        }
+
+        void disable_occlusion_culling()
+        {
+            occlusion_scale = 0;
+            occlusion_buffer = {};
+        }
+
+        void disable_tiled_rendering()
+        {
+            tile_workers.reset();
+        }
+
+        // following render_scene calls map the scene into this rectangle of the framebuffer, and only clear and draw
+        // inside it. call it between render_scene calls for split-screen or thumbnails. also resets the scissor to the viewport.
+        void set_viewport(int x, int y, int width, int height)
+        {
+            viewport_set = true;
+            viewport = {x, y, std::max(width, 1), std::max(height, 1)};
+            scissor = {x, y, x + width - 1, y + height - 1};
+        }
+
+        // limits clearing and drawing further than the viewport does. the part of r outside the viewport is dropped.
+        void set_scissor(const rect_t& r)
+        {
+            rect_t viewport_rect = {viewport.x, viewport.y, viewport.x + viewport.width - 1, viewport.y + viewport.height - 1};
+            scissor = intersect(r, viewport_rect);
+        }
+
+        // goes back to a viewport and scissor that cover the whole window
+        void reset_viewport()
+        {
+            viewport_set = false;
+        }
+
+        // reallocates inv_z_buffer and color_buffer when the window size changed since the last frame.
+        void resize_buffers(int width, int height)
+        {
+            if (width == buffer_width && height == buffer_height)
+                return;
+
+            buffer_width = width;
+            buffer_height = height;
+
+            inv_z_buffer.assign(width * height, 0);
+            color_buffer.assign(width * height, clear_color);
+            tile_dirty.clear();
+        }
+
+        // resets the depth and color of every pixel in r
+        void clear_buffers(const rect_t& r)
+        {
+            int row_width = r.x_max - r.x_min + 1;
+
+            for (int y = r.y_min; y <= r.y_max; y++)
+            {
+                int row_start = y * buffer_width + r.x_min;
+                simd::fill(&inv_z_buffer[row_start], row_width, 0.0f);
+                std::fill_n(&color_buffer[row_start], row_width, clear_color);
+            }
+        }
+
+        void render_scene(const scene_t& scene, const camera_t& cam)
+        {
+            resize_buffers(GetScreenWidth(), GetScreenHeight());
+
+            if (!viewport_set)
+            {
+                viewport = {0, 0, buffer_width, buffer_height};
+                scissor = screen_rect();
+            }
+            scissor = intersect(scissor, screen_rect());
+
+            if (is_empty(scissor))
+                return;
+
+            // everything camera related is the same for every instance of the frame
+            float aspect = (float)viewport.height / (float)viewport.width;
+            frame_view_projection = MatrixMultiply(get_view_matrix(cam), get_projection_matrix(cam, aspect));
+            frame_camera_position = cam.position;
+            frame_pixels_per_unit = viewport.height * 0.5f / tanf(cam.fov * DEG2RAD * 0.5f);
+
+            if (tile_workers)
+            {
+                // tiles clear their own part of the buffers
+                render_tiled(scene);
+            }
+            else
+            {
+                clear_buffers(scissor);
+                tile_dirty.clear();
+
+                render2(scene);
+            }
+
+            // a frame that needed no more scratch memory than an earlier one has to get by without the heap
+            assert(frame_arena.heap_allocations() == 0 || frame_arena.used() > frame_arena.peak());
+
+            frame_triangles = {};
+            tile_bins = nullptr;
+            frame_arena.reset();
+        }
+
+        // uploads the color buffer of the last render_scene call and draws it over the whole window.
+        // has to be called between BeginDrawing and EndDrawing.
+        void present()
+        {
+            int screen_w = GetScreenWidth();
+            int screen_h = GetScreenHeight();
+
+            if ((int)color_buffer.size() != screen_w * screen_h)
+                return;
+
+            if (framebuffer_texture.width != screen_w || framebuffer_texture.height != screen_h)
+            {
+                if (framebuffer_texture.id != 0)
+                    UnloadTexture(framebuffer_texture);
+
+                Image image = {
+                    .data = color_buffer.data(),
+                    .width = screen_w,
+                    .height = screen_h,
+                    .mipmaps = 1,
+                    .format = PIXELFORMAT_UNCOMPRESSED_R8G8B8A8};
+
+                framebuffer_texture = LoadTextureFromImage(image);
+            }
+            else
+            {
+                UpdateTexture(framebuffer_texture, color_buffer.data());
+            }
+
+            DrawTexture(framebuffer_texture, 0, 0, WHITE);
         }
     };
 
@@ -0,0 +1,185 @@
+#pragma once
+
+// thin wrappers around the SSE2/AVX2 intrinsics the rasterizer needs. SSR_SIMD_LANES tells
+// how many pixels one vector holds. define SSR_SIMD_LANES=1 before including this file (or
+// build for a target without SSE2) to get the plain scalar loops.
+#if !defined(SSR_SIMD_LANES)
+#if defined(__AVX2__)
+#define SSR_SIMD_LANES 8
+#elif defined(__SSE2__) || defined(_M_X64)
+#define SSR_SIMD_LANES 4
+#else
+#define SSR_SIMD_LANES 1
+#endif
+#endif
+
+#if SSR_SIMD_LANES == 8
+#include <immintrin.h>
+#elif SSR_SIMD_LANES == 4
+#include <emmintrin.h>
+#endif
+
+#include <cstddef>
+#include <new>
+
+namespace ssr
+{
+    namespace simd
+    {
+#if SSR_SIMD_LANES == 8
+
+        using vf = __m256;
+        using vi = __m256i;
+
+        inline vf set1(float a) { return _mm256_set1_ps(a); }
+        inline vi set1(int a) { return _mm256_set1_epi32(a); }
+
+        // start, start + step, start + 2 * step, ...
+        inline vi ramp(int start, int step)
+        {
+            return _mm256_setr_epi32(start, start + step, start + 2 * step, start + 3 * step,
+                                     start + 4 * step, start + 5 * step, start + 6 * step, start + 7 * step);
+        }
+
+        inline vf ramp(float start, float step)
+        {
+            return _mm256_setr_ps(start, start + step, start + 2 * step, start + 3 * step,
+                                  start + 4 * step, start + 5 * step, start + 6 * step, start + 7 * step);
+        }
+
+        inline vi add(vi a, vi b) { return _mm256_add_epi32(a, b); }
+        inline vf add(vf a, vf b) { return _mm256_add_ps(a, b); }
+        inline vf sub(vf a, vf b) { return _mm256_sub_ps(a, b); }
+        inline vf mul(vf a, vf b) { return _mm256_mul_ps(a, b); }
+        inline vf div(vf a, vf b) { return _mm256_div_ps(a, b); }
+        inline vf min(vf a, vf b) { return _mm256_min_ps(a, b); }
+        inline vf max(vf a, vf b) { return _mm256_max_ps(a, b); }
+
+        inline vf to_float(vi a) { return _mm256_cvtepi32_ps(a); }
+        inline vi to_int(vf a) { return _mm256_cvttps_epi32(a); } // truncates like a (int) cast
+
+        // all bits set in the lanes where a, b and c are all >= 0
+        inline vf all_non_negative(vi a, vi b, vi c)
+        {
+            vi any_sign = _mm256_or_si256(_mm256_or_si256(a, b), c);
+            return _mm256_castsi256_ps(_mm256_cmpgt_epi32(any_sign, _mm256_set1_epi32(-1)));
+        }
+
+        inline vf true_mask() { return _mm256_castsi256_ps(_mm256_set1_epi32(-1)); }
+        inline vf greater(vf a, vf b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+        inline vf less(vf a, vf b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+        inline vf mask_and(vf a, vf b) { return _mm256_and_ps(a, b); }
+        inline vf select(vf mask, vf a, vf b) { return _mm256_blendv_ps(b, a, mask); } // mask ? a : b
+        inline int bits(vf mask) { return _mm256_movemask_ps(mask); }
+        inline vi mask_bits(vf mask, int b) { return _mm256_and_si256(_mm256_castps_si256(mask), _mm256_set1_epi32(b)); } // mask ? b : 0
+        inline vi bit_or(vi a, vi b) { return _mm256_or_si256(a, b); }
+
+        inline vf load(const float *p) { return _mm256_loadu_ps(p); }
+        inline void store(float *p, vf a) { _mm256_storeu_ps(p, a); }
+        inline void store(int *p, vi a) { _mm256_storeu_si256((__m256i *)p, a); }
+
+#elif SSR_SIMD_LANES == 4
+
+        using vf = __m128;
+        using vi = __m128i;
+
+        inline vf set1(float a) { return _mm_set1_ps(a); }
+        inline vi set1(int a) { return _mm_set1_epi32(a); }
+
+        // start, start + step, start + 2 * step, ...
+        inline vi ramp(int start, int step)
+        {
+            return _mm_setr_epi32(start, start + step, start + 2 * step, start + 3 * step);
+        }
+
+        inline vf ramp(float start, float step)
+        {
+            return _mm_setr_ps(start, start + step, start + 2 * step, start + 3 * step);
+        }
+
+        inline vi add(vi a, vi b) { return _mm_add_epi32(a, b); }
+        inline vf add(vf a, vf b) { return _mm_add_ps(a, b); }
+        inline vf sub(vf a, vf b) { return _mm_sub_ps(a, b); }
+        inline vf mul(vf a, vf b) { return _mm_mul_ps(a, b); }
+        inline vf div(vf a, vf b) { return _mm_div_ps(a, b); }
+        inline vf min(vf a, vf b) { return _mm_min_ps(a, b); }
+        inline vf max(vf a, vf b) { return _mm_max_ps(a, b); }
+
+        inline vf to_float(vi a) { return _mm_cvtepi32_ps(a); }
+        inline vi to_int(vf a) { return _mm_cvttps_epi32(a); } // truncates like a (int) cast
+
+        // all bits set in the lanes where a, b and c are all >= 0
+        inline vf all_non_negative(vi a, vi b, vi c)
+        {
+            vi any_sign = _mm_or_si128(_mm_or_si128(a, b), c);
+            return _mm_castsi128_ps(_mm_cmpgt_epi32(any_sign, _mm_set1_epi32(-1)));
+        }
+
+        inline vf true_mask() { return _mm_castsi128_ps(_mm_set1_epi32(-1)); }
+        inline vf greater(vf a, vf b) { return _mm_cmpgt_ps(a, b); }
+        inline vf less(vf a, vf b) { return _mm_cmplt_ps(a, b); }
+        inline vf mask_and(vf a, vf b) { return _mm_and_ps(a, b); }
+        inline vf select(vf mask, vf a, vf b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); } // mask ? a : b
+        inline int bits(vf mask) { return _mm_movemask_ps(mask); }
+        inline vi mask_bits(vf mask, int b) { return _mm_and_si128(_mm_castps_si128(mask), _mm_set1_epi32(b)); } // mask ? b : 0
+        inline vi bit_or(vi a, vi b) { return _mm_or_si128(a, b); }
+
+        inline vf load(const float *p) { return _mm_loadu_ps(p); }
+        inline void store(float *p, vf a) { _mm_storeu_ps(p, a); }
+        inline void store(int *p, vi a) { _mm_storeu_si128((__m128i *)p, a); }
+
+#endif
+
+        // sets count floats starting at p to value. p does not need any particular alignment.
+        inline void fill(float *p, size_t count, float value)
+        {
+            size_t i = 0;
+#if SSR_SIMD_LANES > 1
+            vf v = set1(value);
+            for (; i + SSR_SIMD_LANES <= count; i += SSR_SIMD_LANES)
+            {
+                store(p + i, v);
+            }
+#endif
+            for (; i < count; i++)
+            {
+                p[i] = value;
+            }
+        }
+
+        // std::allocator replacement that hands out memory aligned to Alignment bytes, so buffers
+        // can be walked with full vector loads and stores from their first element.
+        template <typename T, size_t Alignment>
+        struct aligned_allocator
+        {
+            using value_type = T;
+
+            template <typename U>
+            struct rebind
+            {
+                using other = aligned_allocator<U, Alignment>;
+            };
+
+            aligned_allocator() = default;
+
+            template <typename U>
+            aligned_allocator(const aligned_allocator<U, Alignment> &) {}
+
+            T *allocate(size_t n)
+            {
+                return (T *)::operator new(n * sizeof(T), std::align_val_t(Alignment));
+            }
+
+            void deallocate(T *p, size_t)
+            {
+                ::operator delete(p, std::align_val_t(Alignment));
+            }
+
+            template <typename U>
+            bool operator==(const aligned_allocator<U, Alignment> &) const { return true; }
+
+            template <typename U>
+            bool operator!=(const aligned_allocator<U, Alignment> &) const { return false; }
+        };
+    }
+}
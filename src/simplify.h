@@ -0,0 +1,602 @@
+#pragma once
+
+#include "../include/raylib.h"
+#include "../include/raymath.h"
+#include "rendering.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+using std::vector;
+
+namespace ssr
+{
+
+    // sum of squared distances to a set of planes, as a symmetric 4x4 matrix (Garland & Heckbert)
+    struct quadric_t
+    {
+        double xx = 0, xy = 0, xz = 0, xw = 0;
+        double yy = 0, yz = 0, yw = 0;
+        double zz = 0, zw = 0;
+        double ww = 0;
+
+        // the plane is dot(n, p) + d = 0 with a unit length n
+        void add_plane(Vector3 n, float d, float weight)
+        {
+            xx += weight * n.x * n.x;
+            xy += weight * n.x * n.y;
+            xz += weight * n.x * n.z;
+            xw += weight * n.x * d;
+            yy += weight * n.y * n.y;
+            yz += weight * n.y * n.z;
+            yw += weight * n.y * d;
+            zz += weight * n.z * n.z;
+            zw += weight * n.z * d;
+            ww += weight * d * d;
+        }
+
+        void add(const quadric_t &q)
+        {
+            xx += q.xx, xy += q.xy, xz += q.xz, xw += q.xw;
+            yy += q.yy, yz += q.yz, yw += q.yw;
+            zz += q.zz, zw += q.zw;
+            ww += q.ww;
+        }
+
+        double error(Vector3 p) const
+        {
+            double x = p.x, y = p.y, z = p.z;
+            double e = x * x * xx + y * y * yy + z * z * zz + ww +
+                       2 * (x * y * xy + x * z * xz + y * z * yz + x * xw + y * yw + z * zw);
+            return std::max(e, 0.0);
+        }
+    };
+
+    // reduces the face count of a mesh by collapsing edges, cheapest first by the quadric error of the moved position.
+    // collapses are half edge collapses: one end of the edge moves onto the other, so no new vertices are made up and
+    // the result's vertices are a subset of the source's.
+    //
+    // vertices at the same position with different uvs or normals make a seam (or a hard edge). it may only slide along
+    // the seam onto a position that is split the same way, so every side of the seam keeps its own uvs. positions on
+    // open borders only move along the border and positions on edges shared by more than two faces never move.
+    class mesh_simplifier_t
+    {
+    private:
+        enum position_kind_t : uint8_t
+        {
+            POSITION_FREE,
+            POSITION_BORDER,
+            POSITION_LOCKED,
+        };
+
+        struct collapse_t
+        {
+            uint32_t from;
+            uint32_t to;
+            double cost;
+        };
+
+        // quadrics of border edges get this much more weight than the face planes, to keep the outline in place
+        static constexpr float border_weight = 10.0f;
+
+        vector<triangle_t> faces;
+
+        // vertices with the same position are welded into one position, and vertices that are equal in everything
+        // into one wedge. the source may have split equal vertices (clusters do).
+        vector<uint32_t> position_ids;
+        vector<uint32_t> wedge_ids;
+        vector<Vector3> positions;
+        vector<quadric_t> quadrics;
+
+        // topology of the current faces, rebuilt at the start of every pass
+        vector<uint32_t> first_position_face;
+        vector<uint32_t> position_faces;
+        vector<uint8_t> kinds;
+        vector<std::pair<uint32_t, uint32_t>> edges; // lower position first
+
+        vector<uint32_t> marks;
+        uint32_t mark = 0;
+        vector<uint8_t> dirty;
+
+        // wedge of the moved position -> vertex that replaces it
+        vector<std::pair<uint32_t, uint32_t>> corner_map;
+
+        uint32_t id(uint32_t vertex) const
+        {
+            return position_ids[vertex];
+        }
+
+        bool same_wedge(uint32_t a, uint32_t b) const
+        {
+            return wedge_ids[a] == wedge_ids[b];
+        }
+
+        static uint32_t &corner(triangle_t &f, int i)
+        {
+            return i == 0 ? f.v1 : i == 1 ? f.v2 : f.v3;
+        }
+
+        static uint32_t corner(const triangle_t &f, int i)
+        {
+            return i == 0 ? f.v1 : i == 1 ? f.v2 : f.v3;
+        }
+
+        // number of faces around a that also touch b
+        uint32_t edge_face_count(uint32_t a, uint32_t b) const
+        {
+            uint32_t count = 0;
+            for (uint32_t i = first_position_face[a]; i < first_position_face[a + 1]; i++)
+            {
+                const triangle_t &f = faces[position_faces[i]];
+                count += id(f.v1) == b || id(f.v2) == b || id(f.v3) == b;
+            }
+            return count;
+        }
+
+        void weld_vertices(const mesh_t &mesh)
+        {
+            size_t count = mesh.vertices.size();
+            bool has_normals = !mesh.normals.empty();
+
+            vector<uint32_t> order(count);
+            for (size_t i = 0; i < count; i++)
+            {
+                order[i] = (uint32_t)i;
+            }
+
+            auto less3 = [](const Vector3 &p, const Vector3 &q)
+            {
+                return p.x != q.x ? p.x < q.x : p.y != q.y ? p.y < q.y : p.z < q.z;
+            };
+            auto position_less = [&](uint32_t a, uint32_t b)
+            {
+                return less3(mesh.vertices[a], mesh.vertices[b]);
+            };
+            // positions first, so the vertices of one position end up next to each other
+            auto vertex_less = [&](uint32_t a, uint32_t b)
+            {
+                if (less3(mesh.vertices[a], mesh.vertices[b]) || less3(mesh.vertices[b], mesh.vertices[a]))
+                    return less3(mesh.vertices[a], mesh.vertices[b]);
+
+                const Vector2 &s = mesh.uvs[a];
+                const Vector2 &t = mesh.uvs[b];
+                if (s.x != t.x || s.y != t.y)
+                    return s.x != t.x ? s.x < t.x : s.y < t.y;
+
+                return has_normals && less3(mesh.normals[a], mesh.normals[b]);
+            };
+            std::sort(order.begin(), order.end(), vertex_less);
+
+            position_ids.resize(count);
+            wedge_ids.resize(count);
+            positions.clear();
+            uint32_t wedge_count = 0;
+            for (size_t i = 0; i < count; i++)
+            {
+                if (i == 0 || position_less(order[i - 1], order[i]))
+                    positions.push_back(mesh.vertices[order[i]]);
+                if (i == 0 || vertex_less(order[i - 1], order[i]))
+                    wedge_count++;
+
+                position_ids[order[i]] = (uint32_t)(positions.size() - 1);
+                wedge_ids[order[i]] = wedge_count - 1;
+            }
+        }
+
+        // drops faces that collapsed to a line and rebuilds adjacency, edge counts and position kinds
+        void build_topology()
+        {
+            faces.erase(std::remove_if(faces.begin(), faces.end(), [&](const triangle_t &f)
+                                       { return id(f.v1) == id(f.v2) || id(f.v2) == id(f.v3) || id(f.v3) == id(f.v1); }),
+                        faces.end());
+
+            size_t position_count = positions.size();
+
+            first_position_face.assign(position_count + 1, 0);
+            for (const triangle_t &f : faces)
+            {
+                first_position_face[id(f.v1) + 1]++;
+                first_position_face[id(f.v2) + 1]++;
+                first_position_face[id(f.v3) + 1]++;
+            }
+            for (size_t i = 0; i < position_count; i++)
+            {
+                first_position_face[i + 1] += first_position_face[i];
+            }
+
+            position_faces.resize(faces.size() * 3);
+            vector<uint32_t> fill(first_position_face.begin(), first_position_face.end() - 1);
+            for (size_t i = 0; i < faces.size(); i++)
+            {
+                for (int k = 0; k < 3; k++)
+                {
+                    position_faces[fill[id(corner(faces[i], k))]++] = (uint32_t)i;
+                }
+            }
+
+            // every edge once, from the faces around its lower end
+            edges.clear();
+            kinds.assign(position_count, POSITION_FREE);
+            for (uint32_t a = 0; a < position_count; a++)
+            {
+                uint32_t seen = ++mark;
+                for (uint32_t i = first_position_face[a]; i < first_position_face[a + 1]; i++)
+                {
+                    const triangle_t &f = faces[position_faces[i]];
+                    for (int k = 0; k < 3; k++)
+                    {
+                        uint32_t b = id(corner(f, k));
+                        if (b <= a || marks[b] == seen)
+                            continue;
+
+                        marks[b] = seen;
+                        edges.push_back({a, b});
+
+                        uint32_t count = edge_face_count(a, b);
+                        if (count == 2)
+                            continue;
+
+                        uint8_t kind = count == 1 ? POSITION_BORDER : POSITION_LOCKED;
+                        kinds[a] = std::max(kinds[a], kind);
+                        kinds[b] = std::max(kinds[b], kind);
+                    }
+                }
+            }
+        }
+
+        void build_quadrics()
+        {
+            quadrics.assign(positions.size(), {});
+
+            for (const triangle_t &f : faces)
+            {
+                Vector3 p[3] = {positions[id(f.v1)], positions[id(f.v2)], positions[id(f.v3)]};
+                Vector3 n = Vector3CrossProduct(Vector3Subtract(p[1], p[0]), Vector3Subtract(p[2], p[0]));
+
+                float length = Vector3Length(n);
+                if (length == 0)
+                    continue;
+
+                n = Vector3Scale(n, 1.0f / length);
+                quadric_t q;
+                q.add_plane(n, -Vector3DotProduct(n, p[0]), 1.0f);
+
+                for (int k = 0; k < 3; k++)
+                {
+                    quadrics[id(corner(f, k))].add(q);
+                }
+
+                // a plane through every open edge, standing up from the face, keeps border positions from drifting
+                // away from the border
+                for (int k = 0; k < 3; k++)
+                {
+                    uint32_t a = id(corner(f, k));
+                    uint32_t b = id(corner(f, (k + 1) % 3));
+                    if (edge_face_count(a, b) != 1)
+                        continue;
+
+                    Vector3 side = Vector3CrossProduct(Vector3Subtract(positions[b], positions[a]), n);
+                    float side_length = Vector3Length(side);
+                    if (side_length == 0)
+                        continue;
+
+                    side = Vector3Scale(side, 1.0f / side_length);
+                    quadric_t border;
+                    border.add_plane(side, -Vector3DotProduct(side, positions[a]), border_weight);
+                    quadrics[a].add(border);
+                    quadrics[b].add(border);
+                }
+            }
+        }
+
+        // checks whether position from can move onto position to and fills corner_map for the move
+        bool can_collapse(uint32_t from, uint32_t to)
+        {
+            if (kinds[from] == POSITION_LOCKED)
+                return false;
+
+            uint32_t shared_faces = edge_face_count(from, to);
+            if (kinds[from] == POSITION_BORDER && shared_faces != 1)
+                return false;
+
+            // the positions next to both ends have to be exactly the ones across the shared faces, or the collapse
+            // would glue two sheets of the surface together
+            uint32_t to_mark = ++mark;
+            uint32_t counted_mark = ++mark;
+            for (uint32_t i = first_position_face[to]; i < first_position_face[to + 1]; i++)
+            {
+                const triangle_t &f = faces[position_faces[i]];
+                for (int k = 0; k < 3; k++)
+                {
+                    marks[id(corner(f, k))] = to_mark;
+                }
+            }
+
+            uint32_t common = 0;
+            for (uint32_t i = first_position_face[from]; i < first_position_face[from + 1]; i++)
+            {
+                const triangle_t &f = faces[position_faces[i]];
+                for (int k = 0; k < 3; k++)
+                {
+                    uint32_t p = id(corner(f, k));
+                    if (p != from && p != to && marks[p] == to_mark)
+                    {
+                        marks[p] = counted_mark;
+                        common++;
+                    }
+                }
+            }
+            if (common != shared_faces)
+                return false;
+
+            // the faces on the edge tell which corner of to takes over each uv/normal combination of from
+            corner_map.clear();
+            for (uint32_t i = first_position_face[from]; i < first_position_face[from + 1]; i++)
+            {
+                const triangle_t &f = faces[position_faces[i]];
+
+                uint32_t from_corner = 0;
+                uint32_t to_corner = 0;
+                bool has_to = false;
+                for (int k = 0; k < 3; k++)
+                {
+                    if (id(corner(f, k)) == from)
+                        from_corner = corner(f, k);
+                    else if (id(corner(f, k)) == to)
+                        to_corner = corner(f, k), has_to = true;
+                }
+
+                if (!has_to)
+                    continue;
+
+                bool found = false;
+                for (const auto &[wedge, target] : corner_map)
+                {
+                    if (wedge == wedge_ids[from_corner])
+                    {
+                        if (!same_wedge(target, to_corner))
+                            return false;
+                        found = true;
+                    }
+                    else if (same_wedge(target, to_corner))
+                        return false; // two sides of a seam would merge into one
+                }
+
+                if (!found)
+                    corner_map.push_back({wedge_ids[from_corner], to_corner});
+            }
+
+            // every other face around from has to find its corner in the map and must not flip over
+            for (uint32_t i = first_position_face[from]; i < first_position_face[from + 1]; i++)
+            {
+                const triangle_t &f = faces[position_faces[i]];
+
+                Vector3 before[3];
+                Vector3 after[3];
+                bool has_to = false;
+                for (int k = 0; k < 3; k++)
+                {
+                    uint32_t p = id(corner(f, k));
+                    has_to |= p == to;
+                    before[k] = positions[p];
+                    after[k] = p == from ? positions[to] : positions[p];
+
+                    if (p != from)
+                        continue;
+
+                    bool mapped = false;
+                    for (const auto &entry : corner_map)
+                    {
+                        mapped |= entry.first == wedge_ids[corner(f, k)];
+                    }
+                    if (!mapped)
+                        return false; // from is on a seam that doesn't run along this edge
+                }
+
+                if (has_to)
+                    continue;
+
+                Vector3 n0 = Vector3CrossProduct(Vector3Subtract(before[1], before[0]), Vector3Subtract(before[2], before[0]));
+                Vector3 n1 = Vector3CrossProduct(Vector3Subtract(after[1], after[0]), Vector3Subtract(after[2], after[0]));
+                if (Vector3DotProduct(n0, n1) <= 0)
+                    return false;
+            }
+
+            return true;
+        }
+
+        // moves from onto to, can_collapse(from, to) has to have filled corner_map just before.
+        // returns the number of faces that became degenerate.
+        size_t collapse(uint32_t from, uint32_t to)
+        {
+            size_t removed = 0;
+
+            for (uint32_t i = first_position_face[from]; i < first_position_face[from + 1]; i++)
+            {
+                triangle_t &f = faces[position_faces[i]];
+
+                bool has_to = false;
+                for (int k = 0; k < 3; k++)
+                {
+                    uint32_t &c = corner(f, k);
+                    dirty[id(c)] = 1;
+                    has_to |= id(c) == to;
+
+                    if (id(c) != from)
+                        continue;
+
+                    for (const auto &[wedge, target] : corner_map)
+                    {
+                        if (wedge == wedge_ids[c])
+                        {
+                            c = target;
+                            break;
+                        }
+                    }
+                }
+
+                removed += has_to;
+            }
+
+            quadrics[to].add(quadrics[from]);
+            return removed;
+        }
+
+        // the source's vertices cut down to what the faces still use
+        void compact(const mesh_t &source, mesh_t &result) const
+        {
+            bool has_normals = !source.normals.empty();
+            vector<int> remap(source.vertices.size(), -1);
+
+            result = {};
+            vector<uint32_t> indices;
+            indices.reserve(faces.size() * 3);
+            for (const triangle_t &f : faces)
+            {
+                for (int k = 0; k < 3; k++)
+                {
+                    uint32_t v = corner(f, k);
+                    if (remap[v] < 0)
+                    {
+                        remap[v] = (int)result.vertices.size();
+                        result.vertices.push_back(source.vertices[v]);
+                        result.uvs.push_back(source.uvs[v]);
+                        if (has_normals)
+                            result.normals.push_back(source.normals[v]);
+                    }
+                    indices.push_back((uint32_t)remap[v]);
+                }
+            }
+            result.indices.assign(indices.data(), indices.size(), result.vertices.size());
+        }
+
+    public:
+        // simplifies source down to about target_face_count faces, or as far as the seams and borders allow, into
+        // result. returns the geometric error of the result: roughly how far its surface may be from the source's.
+        float simplify(const mesh_t &source, size_t target_face_count, mesh_t &result)
+        {
+            faces.resize(source.face_count());
+            for (size_t i = 0; i < faces.size(); i++)
+            {
+                faces[i] = source.face(i);
+            }
+            weld_vertices(source);
+            marks.assign(positions.size(), 0);
+            mark = 0;
+
+            build_topology();
+            build_quadrics();
+
+            double max_cost = 0;
+
+            while (faces.size() > target_face_count)
+            {
+                // the cheaper direction of every edge. whether the collapse is allowed is only checked for the
+                // candidates that get their turn below.
+                vector<collapse_t> candidates;
+                candidates.reserve(edges.size());
+                for (const auto &[a, b] : edges)
+                {
+                    if (kinds[a] == POSITION_LOCKED && kinds[b] == POSITION_LOCKED)
+                        continue;
+
+                    double a_to_b = kinds[a] == POSITION_LOCKED ? -1 : quadrics[a].error(positions[b]) + quadrics[b].error(positions[b]);
+                    double b_to_a = kinds[b] == POSITION_LOCKED ? -1 : quadrics[a].error(positions[a]) + quadrics[b].error(positions[a]);
+
+                    if (b_to_a < 0 || (a_to_b >= 0 && a_to_b <= b_to_a))
+                        candidates.push_back({a, b, a_to_b});
+                    else
+                        candidates.push_back({b, a, b_to_a});
+                }
+
+                if (candidates.empty())
+                    break;
+
+                // a collapse removes about two faces. looking only a bit past the cheapest ones needed leaves the
+                // pricier collapses to later passes, where cheaper ones may have turned up around them. the last
+                // few passes look at an eighth of the candidates at least, so they don't crawl along a few at a time.
+                size_t wanted = (faces.size() - target_face_count) / 2 + 1;
+                size_t considered = std::min(candidates.size(), std::max(wanted + wanted / 2, candidates.size() / 8));
+
+                auto cheaper = [](const collapse_t &a, const collapse_t &b)
+                { return a.cost < b.cost; };
+                std::nth_element(candidates.begin(), candidates.begin() + considered - 1, candidates.end(), cheaper);
+                std::sort(candidates.begin(), candidates.begin() + considered, cheaper);
+
+                // a position whose faces changed this pass waits for the next one, its checks are out of date
+                dirty.assign(positions.size(), 0);
+
+                size_t face_count = faces.size();
+                size_t collapsed = 0;
+                for (size_t i = 0; i < considered && face_count > target_face_count; i++)
+                {
+                    collapse_t c = candidates[i];
+                    if (dirty[c.from] || dirty[c.to])
+                        continue;
+
+                    // the other direction costs more but may be allowed when this one isn't
+                    if (!can_collapse(c.from, c.to))
+                    {
+                        std::swap(c.from, c.to);
+                        if (!can_collapse(c.from, c.to))
+                            continue;
+
+                        c.cost = quadrics[c.from].error(positions[c.to]) + quadrics[c.to].error(positions[c.to]);
+                    }
+
+                    face_count -= collapse(c.from, c.to);
+                    max_cost = std::max(max_cost, c.cost);
+                    collapsed++;
+                }
+
+                build_topology();
+
+                if (collapsed == 0)
+                    break;
+            }
+
+            compact(source, result);
+            return (float)std::sqrt(max_cost);
+        }
+    };
+
+    constexpr int max_lod_levels = 4;
+    constexpr size_t min_lod_faces = 16;
+
+    // fills mesh.lods with up to max_lod_levels simplified versions of the mesh, each with about half the faces of
+    // the one before. the chain stops early when a level can't get rid of at least a quarter of the faces.
+    // the LODs get their clusters, position streams and bounds here, the mesh itself is left as it is.
+    void build_lods(mesh_t &mesh)
+    {
+        mesh.lods.clear();
+        mesh.lods.reserve(max_lod_levels);
+
+        mesh_simplifier_t simplifier;
+        const mesh_t *previous = &mesh;
+
+        for (int level = 0; level < max_lod_levels; level++)
+        {
+            size_t face_count = previous->face_count();
+            if (face_count < min_lod_faces * 2)
+                break;
+
+            mesh_t lod;
+            float error = simplifier.simplify(*previous, face_count / 2, lod);
+            if (lod.face_count() > face_count * 3 / 4)
+                break;
+
+            // errors of the levels in between add up
+            lod.lod_error = previous->lod_error + error;
+
+            build_clusters(lod);
+            build_position_streams(lod);
+            compute_bounds(lod);
+
+            mesh.lods.push_back(std::move(lod));
+            previous = &mesh.lods.back();
+        }
+    }
+
+}
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+using std::vector;
+
+namespace ssr
+{
+
+    // a fixed set of worker threads that run parallel_for jobs. the calling thread works on
+    // the job too, so a pool of size 1 has no extra threads and just runs everything inline.
+    class thread_pool_t
+    {
+    private:
+        vector<std::thread> workers;
+
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::condition_variable done;
+
+        // the current job. the callable is type erased by hand so starting a job never allocates.
+        void (*job_fn)(void *ctx, int index) = nullptr;
+        void *job_ctx = nullptr;
+        int job_count = 0;
+        std::atomic<int> next_index = {0};
+
+        unsigned generation = 0; // bumped for every job so sleeping workers know there is new work
+        int busy_workers = 0;
+        bool stopping = false;
+
+        void run_job_items()
+        {
+            for (;;)
+            {
+                int i = next_index.fetch_add(1);
+                if (i >= job_count)
+                    return;
+
+                job_fn(job_ctx, i);
+            }
+        }
+
+        void worker_loop()
+        {
+            unsigned seen_generation = 0;
+
+            for (;;)
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&]
+                          { return stopping || generation != seen_generation; });
+
+                if (stopping)
+                    return;
+
+                seen_generation = generation;
+                lock.unlock();
+
+                run_job_items();
+
+                lock.lock();
+                if (--busy_workers == 0)
+                    done.notify_one();
+            }
+        }
+
+    public:
+        // thread_count <= 0 means one thread per hardware core
+        explicit thread_pool_t(int thread_count)
+        {
+            if (thread_count <= 0)
+                thread_count = (int)std::max(1u, std::thread::hardware_concurrency());
+
+            for (int i = 1; i < thread_count; i++)
+            {
+                workers.emplace_back([this]
+                                     { worker_loop(); });
+            }
+        }
+
+        ~thread_pool_t()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wake.notify_all();
+
+            for (std::thread &w : workers)
+            {
+                w.join();
+            }
+        }
+
+        thread_pool_t(const thread_pool_t &) = delete;
+        thread_pool_t &operator=(const thread_pool_t &) = delete;
+
+        int size() const
+        {
+            return (int)workers.size() + 1;
+        }
+
+        // calls fn(i) for every i in [0, count) spread over all threads and returns once all calls are done.
+        template <typename F>
+        void parallel_for(int count, F &&fn)
+        {
+            if (workers.empty() || count <= 1)
+            {
+                for (int i = 0; i < count; i++)
+                {
+                    fn(i);
+                }
+                return;
+            }
+
+            using fn_t = std::remove_reference_t<F>;
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                job_fn = [](void *ctx, int index)
+                { (*(fn_t *)ctx)(index); };
+                job_ctx = (void *)&fn;
+                job_count = count;
+                next_index = 0;
+                busy_workers = (int)workers.size();
+                generation++;
+            }
+            wake.notify_all();
+
+            run_job_items();
+
+            std::unique_lock<std::mutex> lock(mutex);
+            done.wait(lock, [&]
+                      { return busy_workers == 0; });
+            job_fn = nullptr;
+            job_ctx = nullptr;
+        }
+    };
+
+}